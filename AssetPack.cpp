@@ -0,0 +1,115 @@
+#include "AssetPack.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+uint64_t fnv1a64(uint8_t const *data, size_t size) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+AssetPack::AssetPack(std::string const &filename, std::string const &prefix_, bool verify_entries_) : mapped(filename), prefix(prefix_), verify_entries(verify_entries_) {
+	ChunkReader toc(mapped.data(), mapped.size(), filename);
+	ChunkSpan< PackEntry > list = toc.read< PackEntry >("pke0");
+	ChunkSpan< char > names = toc.read< char >("str0");
+
+	for (auto const &entry : list) {
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= names.size())) {
+			throw std::runtime_error("Pack '" + filename + "' has an entry with out-of-range name begin/end.");
+		}
+		std::string name(names.data() + entry.name_begin, names.data() + entry.name_end);
+		if (entry.offset % PackAlignment != 0) {
+			throw std::runtime_error("Pack '" + filename + "' entry '" + name + "' is not aligned.");
+		}
+		if (entry.offset < toc.offset || entry.offset > mapped.size() || entry.size > mapped.size() - entry.offset) {
+			throw std::runtime_error("Pack '" + filename + "' entry '" + name + "' is out of range.");
+		}
+		if (entry.compression != Stored) {
+			throw std::runtime_error("Pack '" + filename + "' entry '" + name + "' uses unsupported compression " + std::to_string(entry.compression) + ".");
+		}
+		if (entry.original_size != entry.size) {
+			throw std::runtime_error("Pack '" + filename + "' entry '" + name + "' has inconsistent sizes.");
+		}
+		bool inserted = entries.emplace(prefix + name, entry).second;
+		if (!inserted) {
+			std::cerr << "WARNING: pack '" << filename << "' contains '" << name << "' more than once; using the first." << std::endl;
+		}
+	}
+}
+
+AssetPack::PackEntry const *AssetPack::find(std::string const &path) const {
+	auto f = entries.find(path);
+	if (f == entries.end()) return nullptr;
+	return &f->second;
+}
+
+bool AssetPack::verify(PackEntry const &entry) const {
+	return fnv1a64(data(entry), size_t(entry.size)) == entry.hash;
+}
+
+void AssetPack::check_once(PackEntry const &entry, std::string const &path) const {
+	if (!verify_entries) return;
+	{
+		std::unique_lock< std::mutex > lock(verified_mutex);
+		if (verified.count(&entry)) return;
+	}
+	//(hash outside the lock; two threads opening the same entry at once may both hash it, which is harmless)
+	if (!verify(entry)) {
+		throw std::runtime_error("Pack '" + mapped.filename + "' entry '" + path + "' does not match its hash (corrupted or truncated pack?).");
+	}
+	std::unique_lock< std::mutex > lock(verified_mutex);
+	verified.emplace(&entry);
+}
+
+//------------------------------------------------
+
+namespace {
+	std::vector< std::unique_ptr< AssetPack > > &get_mounted_packs() {
+		static std::vector< std::unique_ptr< AssetPack > > packs;
+		return packs;
+	}
+}
+
+void mount_asset_pack(std::string const &filename, std::string const &prefix, bool verify) {
+	std::string use_prefix = prefix;
+	if (use_prefix.empty()) {
+		auto slash = filename.find_last_of("/\\");
+		if (slash != std::string::npos) use_prefix = filename.substr(0, slash + 1);
+	}
+	auto &packs = get_mounted_packs();
+	packs.emplace(packs.begin(), new AssetPack(filename, use_prefix, verify));
+	std::cout << "Mounted asset pack '" << filename << "' (" << packs.front()->entries.size() << " files)." << std::endl;
+}
+
+AssetFile::AssetFile(std::string const &filename_) : filename(filename_) {
+	for (auto const &pack : get_mounted_packs()) {
+		if (AssetPack::PackEntry const *entry = pack->find(filename)) {
+			pack->check_once(*entry, filename);
+			bytes = pack->data(*entry);
+			length = size_t(entry->size);
+			packed = true;
+			mapping = &pack->mapped;
+			return;
+		}
+	}
+	loose.reset(new MappedFile(filename));
+	bytes = loose->data();
+	length = loose->size();
+	mapping = loose.get();
+}
+
+void AssetFile::release(uint8_t const *begin, size_t size) const {
+	//(only ranges within this asset -- not, say, other entries of the same pack)
+	if (!mapping || begin < bytes || begin + size > bytes + length) return;
+	mapping->release(begin, size);
+}
+
+AssetFile::~AssetFile() {
+}
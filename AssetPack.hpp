@@ -0,0 +1,113 @@
+#pragma once
+
+/*
+ * An AssetPack is many asset files (.pnct, .scene, .png, ...) stored in one
+ * memory-mapped file, so loading opens one file instead of many.
+ *
+ * Pack layout (in read_write_chunk.hpp's chunk format):
+ *  "pke0" chunk -- table of contents, one PackEntry per file
+ *  "str0" chunk -- entry names (paths relative to the pack's directory)
+ *  ...padding, then each entry's bytes, starting on a PackAlignment boundary
+ *
+ * Packs are built by scenes/pack-assets.py.
+ *
+ * Usage:
+ *  //at startup (before loading):
+ *  mount_asset_pack(data_path("assets.pack"));
+ *
+ *  //in loading code, instead of opening a file:
+ *  AssetFile file(data_path("level.pnct")); //(from a mounted pack if one has it, otherwise from disk)
+ *  read_from(file.data(), file.size());
+ *
+ * The first time AssetFile opens an entry, its bytes are checked against the
+ * entry's hash (so a truncated or corrupted pack fails loudly instead of being
+ * parsed); mount with verify = false to skip this.
+ *
+ */
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+struct AssetPack {
+	//map a pack and read its table of contents:
+	// entries are found by 'prefix + name' (by default, the directory containing the pack)
+	// note: throws if the pack can't be read
+	AssetPack(std::string const &filename, std::string const &prefix, bool verify_entries = true);
+
+	enum : uint64_t { PackAlignment = 64 }; //(offsets of entry data are multiples of this)
+
+	enum Compression : uint32_t {
+		Stored = 0,
+	};
+
+	//on-disk table of contents entry:
+	struct PackEntry {
+		uint64_t offset; //of stored bytes, from start of pack
+		uint64_t size; //stored bytes
+		uint64_t original_size; //bytes after decompression (== size when Stored)
+		uint64_t hash; //fnv1a64() of the original bytes
+		uint32_t name_begin, name_end; //range in the "str0" chunk
+		uint32_t compression; //a Compression value
+		uint32_t reserved;
+	};
+	static_assert(sizeof(PackEntry) == 8*4 + 4*4, "PackEntry is packed.");
+
+	//look up an entry by full path (returns nullptr if not in this pack):
+	PackEntry const *find(std::string const &path) const;
+
+	//stored bytes of an entry (in place, in the mapping):
+	uint8_t const *data(PackEntry const &entry) const { return mapped.data() + entry.offset; }
+
+	//check an entry's bytes against its hash:
+	bool verify(PackEntry const &entry) const;
+
+	//verify an entry the first time it is opened (if verify_entries is set):
+	// note: throws if the entry doesn't match its hash
+	void check_once(PackEntry const &entry, std::string const &path) const;
+
+	MappedFile mapped;
+	std::string prefix;
+	std::unordered_map< std::string, PackEntry > entries; //by full path
+
+	bool verify_entries = true;
+	mutable std::mutex verified_mutex; //(AssetFiles may be opened from worker threads)
+	mutable std::unordered_set< PackEntry const * > verified; //entries that have passed check_once()
+};
+
+//64-bit FNV-1a hash (used for pack entry hashes, and elsewhere as a general-purpose byte hash):
+uint64_t fnv1a64(uint8_t const *data, size_t size);
+
+//add a pack to the list searched by AssetFile (later mounts are searched first):
+// (prefix defaults to the directory containing the pack; call before any loading starts)
+// (verify: check each entry against its hash the first time it is opened)
+void mount_asset_pack(std::string const &filename, std::string const &prefix = "", bool verify = true);
+
+//the bytes of an asset file -- from the first mounted pack containing it, or from the file itself:
+struct AssetFile {
+	AssetFile(std::string const &filename); //throws if the file can't be found
+	~AssetFile();
+
+	uint8_t const *data() const { return bytes; }
+	size_t size() const { return length; }
+
+	//let pages of [begin, begin+size) be dropped from memory (see MappedFile::release):
+	void release(uint8_t const *begin, size_t size) const;
+
+	std::string filename;
+	bool packed = false; //came from a pack?
+
+	//--- internals ---
+	uint8_t const *bytes = nullptr;
+	size_t length = 0;
+	std::unique_ptr< MappedFile > loose; //(if not from a pack)
+	MappedFile const *mapping = nullptr; //(the loose file or the pack's mapping)
+
+	AssetFile(AssetFile const &) = delete;
+	AssetFile &operator=(AssetFile const &) = delete;
+};
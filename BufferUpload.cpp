@@ -0,0 +1,129 @@
+#include "BufferUpload.hpp"
+
+#include "ThreadPool.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+BufferUpload buffer_upload;
+
+namespace {
+	//touch one byte per page of [begin,end), so any page faults (disk reads) happen on this thread:
+	void read_ahead(uint8_t const *begin, uint8_t const *end) {
+		constexpr size_t Page = 4096;
+		uint8_t sum = 0;
+		for (uint8_t const *at = begin; at < end; at += Page) {
+			sum += *reinterpret_cast< uint8_t const volatile * >(at);
+		}
+		(void)sum;
+	}
+}
+
+void BufferUpload::upload(GLuint buffer, void const *data_, size_t size, GLenum usage,
+	std::function< void(uint8_t const *, size_t) > const &release) {
+	uint8_t const *data = reinterpret_cast< uint8_t const * >(data_);
+
+	//(the copy-write binding is used so element array bindings in the current vertex array object aren't disturbed)
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+	if (size <= SliceBytes) {
+		glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		if (release && size) release(data, size);
+		return;
+	}
+
+	glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, usage);
+
+	//at most one read-ahead job is outstanding at a time:
+	std::shared_ptr< std::atomic< bool > > reading;
+	auto wait_for_reading = [&reading]() {
+		while (reading && !reading->load()) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		reading.reset();
+	};
+
+	for (size_t offset = 0; offset < size; offset += SliceBytes) {
+		size_t amount = std::min< size_t >(SliceBytes, size - offset);
+
+		//read ahead through the next slice while this one is copied:
+		wait_for_reading();
+		if (offset + amount < size) {
+			reading = std::make_shared< std::atomic< bool > >(false);
+			uint8_t const *begin = data + offset + amount;
+			uint8_t const *end = begin + std::min< size_t >(SliceBytes, size - offset - amount);
+			std::shared_ptr< std::atomic< bool > > done = reading;
+			ThreadPool::shared().run([begin, end, done]() {
+				read_ahead(begin, end);
+				*done = true;
+			});
+		}
+
+		Slice &slice = slices[next_slice];
+		next_slice = (next_slice + 1) % SliceCount;
+
+		if (slice.buffer == 0) {
+			glGenBuffers(1, &slice.buffer);
+			glBindBuffer(GL_COPY_READ_BUFFER, slice.buffer);
+			glBufferData(GL_COPY_READ_BUFFER, SliceBytes, nullptr, GL_STREAM_DRAW);
+		}
+
+		//wait until the GPU has finished the previous copy out of this staging buffer:
+		if (slice.fence) {
+			GLenum result = glClientWaitSync(slice.fence, 0, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+				waits += 1;
+				do {
+					result = glClientWaitSync(slice.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); //(1s; loops until done)
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(slice.fence);
+			slice.fence = 0;
+		}
+
+		//fill the staging buffer (no synchronization needed -- the fence says the GPU is done with it):
+		glBindBuffer(GL_COPY_READ_BUFFER, slice.buffer);
+		void *ptr = glMapBufferRange(GL_COPY_READ_BUFFER, 0, amount, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (ptr) {
+			std::memcpy(ptr, data + offset, amount);
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+		} else {
+			//(mapping is allowed to fail)
+			glBufferSubData(GL_COPY_READ_BUFFER, 0, amount, data + offset);
+		}
+
+		//...and copy it into place on the GPU:
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, GLintptr(offset), GLsizeiptr(amount));
+		slice.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		if (release) release(data + offset, amount);
+
+		bytes += amount;
+		slices_uploaded += 1;
+	}
+	wait_for_reading(); //(the job reads 'data', which the caller may free once this returns)
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	GL_ERRORS();
+}
+
+void BufferUpload::finish() {
+	for (auto &slice : slices) {
+		if (slice.fence) {
+			glDeleteSync(slice.fence);
+			slice.fence = 0;
+		}
+		if (slice.buffer) {
+			glDeleteBuffers(1, &slice.buffer);
+			slice.buffer = 0;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ * BufferUpload fills large buffer objects a slice at a time, so that loading
+ * a big file needs neither a second whole-file copy in the driver nor all
+ * of the file in memory at once.
+ *
+ * The destination's storage is allocated up front (glBufferData with no data);
+ * then each slice is copied into one of a small ring of staging buffers and
+ * copied on the GPU (glCopyBufferSubData) into place. While one slice is being
+ * copied, a worker thread reads ahead through the next one, so disk reads of
+ * memory-mapped data overlap the upload.
+ *
+ * Memory used for staging is capped at SliceCount * SliceBytes, whatever the
+ * size of the upload. The optional 'release' callback is told about each range
+ * of the source as soon as it has been copied (e.g., so a mapped file can let
+ * those pages go).
+ *
+ * Usage (on the thread that owns the GL context):
+ *  GLuint buffer = 0;
+ *  glGenBuffers(1, &buffer);
+ *  buffer_upload.upload(buffer, data, size);
+ *
+ *  //before destroying the GL context:
+ *  buffer_upload.finish();
+ *
+ */
+
+#include "GL.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+struct BufferUpload {
+	//allocate 'size' bytes of storage for 'buffer' and fill it from 'data':
+	// (uploads of at most one slice just use glBufferData)
+	void upload(GLuint buffer, void const *data, size_t size, GLenum usage = GL_STATIC_DRAW,
+		std::function< void(uint8_t const *, size_t) > const &release = nullptr);
+
+	//release the staging buffers:
+	void finish();
+
+	//--- internals ---
+	enum : uint32_t {
+		SliceBytes = 4 << 20,
+		SliceCount = 3,
+	};
+	struct Slice {
+		GLuint buffer = 0; //staging buffer object (SliceBytes, created on first use)
+		GLsync fence = 0; //set after the copy out of 'buffer' is queued
+	} slices[SliceCount];
+	uint32_t next_slice = 0;
+
+	//stats:
+	uint64_t bytes = 0; //uploaded through staging
+	uint64_t slices_uploaded = 0;
+	uint64_t waits = 0; //times a staging buffer was still in use by the GPU
+};
+
+extern BufferUpload buffer_upload;
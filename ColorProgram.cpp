@@ -3,7 +3,8 @@
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
-Load< ColorProgram > color_program(LoadTagEarly);
+//(lazy, since only executables that actually draw lines need it)
+LazyLoad< ColorProgram > color_program("ColorProgram");
 
 ColorProgram::ColorProgram() {
 	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
@@ -18,4 +18,4 @@ struct ColorProgram {
 	// none
 };
 
-extern Load< ColorProgram > color_program;
+extern LazyLoad< ColorProgram > color_program;
@@ -1,31 +1,29 @@
 #include "DrawLines.hpp"
 #include "PathFont.hpp"
 #include "ColorProgram.hpp"
+#include "StreamBuffer.hpp"
 
 #include "gl_errors.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-//All DrawLines instances share a vertex array object and vertex buffer, initialized at load time:
+//All DrawLines instances share a vertex array object, initialized when the first one is drawn,
+// which reads vertices from the shared streaming buffer (see StreamBuffer.hpp):
 
 //n.b. declared static so they don't conflict with similarly named global variables elsewhere:
-static GLuint vertex_buffer = 0;
-static GLuint vertex_buffer_for_color_program = 0;
-
-static Load< void > setup_buffers(LoadTagDefault, [](){
+static LazyLoad< GLuint > vertex_buffer_for_color_program("DrawLines vertex array", []() -> GLuint const * {
 	//you may recognize this init code from DrawSprites.cpp:
+	GLuint *vao = new GLuint(0);
 
-	{ //set up vertex buffer:
-		glGenBuffers(1, &vertex_buffer);
-		//for now, buffer will be un-filled.
-	}
+	//vertices are written to the stream buffer when DrawLines instances are destroyed:
+	GLuint vertex_buffer = stream_buffer.gl_buffer();
 
 	{ //vertex array mapping buffer for color_program:
-		//ask OpenGL to fill vertex_buffer_for_color_program with the name of an unused vertex array object:
-		glGenVertexArrays(1, &vertex_buffer_for_color_program);
+		//ask OpenGL to fill vao with the name of an unused vertex array object:
+		glGenVertexArrays(1, vao);
 
-		//set vertex_buffer_for_color_program as the current vertex array object:
-		glBindVertexArray(vertex_buffer_for_color_program);
+		//set vao as the current vertex array object:
+		glBindVertexArray(*vao);
 
 		//set vertex_buffer as the source of glVertexAttribPointer() commands:
 		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
@@ -60,6 +58,8 @@ static Load< void > setup_buffers(LoadTagDefault, [](){
 	}
 
 	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
+
+	return vao;
 });
 
 
@@ -137,10 +137,9 @@ DrawLines::~DrawLines() {
 
 	//based on DrawSprites.cpp :
 
-	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
-	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_STREAM_DRAW); //upload attribs array
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//copy vertices into the stream buffer:
+	// (aligned to the vertex size, so the offset can be turned into a first vertex for glDrawArrays)
+	GLintptr offset = stream_buffer.write(attribs.data(), attribs.size() * sizeof(attribs[0]), sizeof(attribs[0]));
 
 	//set color_program as current program:
 	glUseProgram(color_program->program);
@@ -149,10 +148,10 @@ DrawLines::~DrawLines() {
 	glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
 
 	//use the mapping vertex_buffer_for_color_program to fetch vertex data:
-	glBindVertexArray(vertex_buffer_for_color_program);
+	glBindVertexArray(*vertex_buffer_for_color_program);
 
 	//run the OpenGL pipeline:
-	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
+	glDrawArrays(GL_LINES, GLint(offset / sizeof(attribs[0])), GLsizei(attribs.size()));
 
 	//reset vertex array to none:
 	glBindVertexArray(0);
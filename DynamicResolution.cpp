@@ -0,0 +1,113 @@
+#include "DynamicResolution.hpp"
+
+#include "GPUProfiler.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+DynamicResolution dynamic_resolution;
+
+void DynamicResolution::update_scale() {
+	float clear_ms = gpu_profiler.latest_ms("clear");
+	float scene_ms = gpu_profiler.latest_ms("scene");
+	if (scene_ms < 0.0f) return; //nothing measured yet
+	float ms = scene_ms + std::max(0.0f, clear_ms);
+
+	if (smoothed_ms < 0.0f) smoothed_ms = ms;
+	else smoothed_ms += 0.2f * (ms - smoothed_ms);
+
+	if (settle > 0) {
+		settle -= 1;
+		return;
+	}
+
+	//leave the scale alone when close to the budget (avoids hunting back and forth):
+	float ratio = smoothed_ms / budget_ms;
+	if (ratio > 0.9f && ratio < 1.05f) return;
+
+	//pass time is roughly proportional to pixel count, i.e. scale^2:
+	float target = scale * std::sqrt(0.95f / ratio);
+	//drop quickly when over budget, recover slowly:
+	target = std::min(target, scale * 1.05f);
+	target = std::max(target, scale * 0.75f);
+	target = std::max(min_scale, std::min(max_scale, target));
+
+	if (std::abs(target - scale) > 0.005f) {
+		scale = target;
+		//wait for measurements made at the new scale before adjusting again:
+		settle = GPUProfiler::FramesInFlight + 1;
+		smoothed_ms = -1.0f;
+	}
+}
+
+void DynamicResolution::allocate(glm::uvec2 const &size) {
+	if (framebuffer == 0) {
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(1, &color);
+		glGenRenderbuffers(1, &depth);
+	}
+
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Dynamic resolution framebuffer is incomplete.");
+	}
+
+	allocated = size;
+	GL_ERRORS();
+}
+
+glm::uvec2 DynamicResolution::begin(glm::uvec2 const &drawable_size) {
+	if (!enabled || drawable_size.x == 0 || drawable_size.y == 0) {
+		render_size = drawable_size;
+		return render_size;
+	}
+
+	update_scale();
+
+	if (allocated != drawable_size) allocate(drawable_size);
+
+	render_size = glm::uvec2(
+		std::max(1u, std::min(drawable_size.x, uint32_t(std::round(drawable_size.x * scale)))),
+		std::max(1u, std::min(drawable_size.y, uint32_t(std::round(drawable_size.y * scale))))
+	);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, render_size.x, render_size.y);
+
+	//(clears should only touch the used corner, since the rest of the target is never shown)
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, render_size.x, render_size.y);
+
+	return render_size;
+}
+
+void DynamicResolution::end(glm::uvec2 const &drawable_size) {
+	if (!enabled || drawable_size.x == 0 || drawable_size.y == 0) return;
+
+	glDisable(GL_SCISSOR_TEST);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(
+		0, 0, render_size.x, render_size.y,
+		0, 0, drawable_size.x, drawable_size.y,
+		GL_COLOR_BUFFER_BIT, (render_size == drawable_size ? GL_NEAREST : GL_LINEAR)
+	);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glViewport(0, 0, drawable_size.x, drawable_size.y);
+
+	GL_ERRORS();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/*
+ * DynamicResolution renders the 3D part of a frame into an offscreen target
+ * whose size follows the GPU time the frame actually takes.
+ *
+ * A controller compares the "clear" and "scene" pass times from gpu_profiler
+ * to a budget. It shrinks the render scale when those passes run over the
+ * budget and grows it back when there is headroom. The result is upscaled
+ * into the default framebuffer with a linear blit, so anything drawn
+ * afterwards (the HUD) stays at native resolution.
+ *
+ * The target is allocated at full drawable size and only a corner of it is
+ * used, so scale changes never reallocate anything.
+ *
+ * Usage:
+ *  //at startup (does nothing until enabled):
+ *  dynamic_resolution.enabled = true;
+ *  dynamic_resolution.budget_ms = 8.0f;
+ *
+ *  //in a draw function:
+ *  dynamic_resolution.begin(drawable_size); //binds the offscreen target and sets the viewport
+ *  //...clear, draw scene...
+ *  dynamic_resolution.end(drawable_size); //blits to the default framebuffer
+ *  //...draw HUD...
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct DynamicResolution {
+	bool enabled = false;
+	float budget_ms = 8.0f; //target GPU time for the scaled passes
+	float min_scale = 0.5f; //smallest allowed fraction of drawable size (per axis)
+	float max_scale = 1.0f;
+
+	float scale = 1.0f; //current fraction of drawable size (per axis)
+
+	//update the scale, bind the offscreen target, and set the viewport to its used corner:
+	// returns the size being rendered at (== drawable_size when not enabled)
+	glm::uvec2 begin(glm::uvec2 const &drawable_size);
+
+	//upscale into the default framebuffer and restore the full viewport:
+	void end(glm::uvec2 const &drawable_size);
+
+	//--- internals ---
+	GLuint framebuffer = 0;
+	GLuint color = 0, depth = 0; //renderbuffers
+	glm::uvec2 allocated = glm::uvec2(0);
+	glm::uvec2 render_size = glm::uvec2(0);
+
+	float smoothed_ms = -1.0f; //moving average of measured time
+	uint32_t settle = 0; //frames to wait before adjusting again (measurements lag by a few frames)
+
+	void update_scale();
+	void allocate(glm::uvec2 const &size);
+};
+
+extern DynamicResolution dynamic_resolution;
@@ -0,0 +1,47 @@
+#include "FramePipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+FramePipeline frame_pipeline;
+
+void FramePipeline::begin_frame() {
+	frames_in_flight = std::max(1u, std::min(uint32_t(MaxFramesInFlight), frames_in_flight));
+
+	auto before = std::chrono::high_resolution_clock::now();
+	bool waited = false;
+	while (in_flight.size() >= frames_in_flight) {
+		GLenum result = glClientWaitSync(in_flight.front(), 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+			waited = true;
+		}
+		wait_oldest();
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+
+	last_wait_ms = (waited ? std::chrono::duration< float, std::milli >(after - before).count() : 0.0f);
+	if (waited) waited_frames += 1;
+}
+
+void FramePipeline::end_frame() {
+	in_flight.emplace_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	//make sure the GPU starts on this frame now, rather than whenever the driver's queue fills up:
+	glFlush();
+	frames += 1;
+}
+
+void FramePipeline::finish() {
+	while (!in_flight.empty()) {
+		wait_oldest();
+	}
+}
+
+void FramePipeline::wait_oldest() {
+	GLsync fence = in_flight.front();
+	GLenum result;
+	do {
+		result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); //(1s; loops until done)
+	} while (result == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(fence);
+	in_flight.pop_front();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * FramePipeline lets the CPU work on the next frame while the GPU is still
+ * drawing earlier ones, and caps how far ahead it can get.
+ *
+ * end_frame() puts a fence after each frame's commands (including the swap)
+ * and flushes them to the GPU without waiting. begin_frame() goes right before
+ * a frame starts issuing GL commands. If 'frames_in_flight' frames are
+ * still unfinished, it waits for the oldest one. So event handling and
+ * update() always overlap the GPU work of the previous frame. The setting
+ * chooses between lower latency (1) and more overlap (2 or 3).
+ *
+ * Anything the CPU rewrites every frame must not be overwritten while the GPU
+ * may still be reading it. StreamBuffer (DrawLines), GPUProfiler and
+ * ScreenCapture all keep fenced rings for this.
+ *
+ * Usage:
+ *  //in the main loop:
+ *  //...handle events, update...
+ *  frame_pipeline.begin_frame();
+ *  //...draw...
+ *  SDL_GL_SwapWindow(window);
+ *  frame_pipeline.end_frame();
+ *
+ */
+
+#include "GL.hpp"
+
+#include <cstdint>
+#include <deque>
+
+struct FramePipeline {
+	enum : uint32_t {
+		MaxFramesInFlight = 3
+	};
+	uint32_t frames_in_flight = 2; //(clamped to [1, MaxFramesInFlight])
+
+	//wait (if needed) until fewer than frames_in_flight frames are unfinished on the GPU:
+	void begin_frame();
+
+	//fence and flush the commands issued since begin_frame():
+	void end_frame();
+
+	//wait for every frame to finish (e.g., before tearing down):
+	void finish();
+
+	//stats:
+	float last_wait_ms = 0.0f; //time begin_frame() spent waiting for the GPU, last frame
+	uint64_t frames = 0;
+	uint64_t waited_frames = 0; //frames where begin_frame() had to wait
+
+	//--- internals ---
+	std::deque< GLsync > in_flight; //oldest first
+	void wait_oldest();
+};
+
+extern FramePipeline frame_pipeline;
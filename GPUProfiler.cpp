@@ -0,0 +1,163 @@
+#include "GPUProfiler.hpp"
+
+#include "DrawLines.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+GPUProfiler gpu_profiler;
+
+uint32_t GPUProfiler::pass_index(std::string const &name) {
+	auto f = std::find(pass_names.begin(), pass_names.end(), name);
+	if (f != pass_names.end()) return uint32_t(f - pass_names.begin());
+	pass_names.emplace_back(name);
+	pass_latest_ms.emplace_back(-1.0f);
+	return uint32_t(pass_names.size() - 1);
+}
+
+void GPUProfiler::begin_frame() {
+	assert(!in_frame && "begin_frame() called twice without end_frame()");
+
+	if (!initialized) {
+		for (auto &frame : frames) {
+			glGenQueries(MaxPasses, frame.queries);
+		}
+		initialized = true;
+	}
+
+	Frame &frame = frames[frame_number % FramesInFlight];
+	if (frame.pending) {
+		//last chance to read back the results from FramesInFlight frames ago:
+		collect(frame);
+		//if the GPU *still* isn't done, drop those results rather than wait:
+		frame.pending = false;
+	}
+	frame.number = frame_number;
+	frame.used = 0;
+
+	in_frame = true;
+}
+
+void GPUProfiler::end_frame() {
+	assert(in_frame && "end_frame() called without begin_frame()");
+	if (in_pass) end();
+
+	Frame &frame = frames[frame_number % FramesInFlight];
+	frame.pending = (frame.used > 0);
+
+	in_frame = false;
+	frame_number += 1;
+
+	//pick up results from earlier frames that have become available:
+	for (auto &f : frames) {
+		if (f.pending && f.number != frame.number) collect(f);
+	}
+}
+
+void GPUProfiler::begin(std::string const &name) {
+	if (!in_frame) return;
+	assert(!in_pass && "GPUProfiler passes may not nest");
+
+	Frame &frame = frames[frame_number % FramesInFlight];
+	if (frame.used == MaxPasses) return; //out of queries; ignore extra passes
+
+	frame.passes[frame.used] = pass_index(name);
+	glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.used]);
+	frame.used += 1;
+	in_pass = true;
+}
+
+void GPUProfiler::end() {
+	if (!in_pass) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	in_pass = false;
+}
+
+GPUProfiler::Pass::Pass(std::string const &name) {
+	gpu_profiler.begin(name);
+}
+
+GPUProfiler::Pass::~Pass() {
+	gpu_profiler.end();
+}
+
+void GPUProfiler::collect(Frame &frame) {
+	assert(frame.pending);
+
+	//results must all be available before any are used, so a frame is reported all-at-once:
+	for (uint32_t i = 0; i < frame.used; ++i) {
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available != GL_TRUE) return;
+	}
+
+	for (uint32_t i = 0; i < frame.used; ++i) {
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+		float ms = float(double(ns) / 1.0e6);
+		pass_latest_ms[frame.passes[i]] = ms;
+		if (csv.is_open()) {
+			csv << frame.number << ',' << pass_names[frame.passes[i]] << ',' << ms << '\n';
+		}
+	}
+	frame.pending = false;
+}
+
+float GPUProfiler::latest_ms(std::string const &name) const {
+	auto f = std::find(pass_names.begin(), pass_names.end(), name);
+	if (f == pass_names.end()) return -1.0f;
+	return pass_latest_ms[f - pass_names.begin()];
+}
+
+void GPUProfiler::start_csv(std::string const &filename) {
+	csv.open(filename);
+	if (!csv.is_open()) {
+		throw std::runtime_error("Failed to open GPU profile CSV '" + filename + "' for writing.");
+	}
+	csv << "frame,pass,gpu_ms\n";
+}
+
+void GPUProfiler::draw_overlay(glm::uvec2 const &drawable_size) const {
+	if (!show_overlay || pass_names.empty()) return;
+
+	glDisable(GL_DEPTH_TEST);
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	DrawLines lines(glm::mat4(
+		1.0f / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	));
+
+	constexpr float H = 0.05f; //text height
+	constexpr float BarScale = 1.0f / 16.667f; //bar length per millisecond (a 60Hz frame is one unit long)
+	float label_x = -aspect + 0.5f * H;
+	float bar_x = label_x + 8.0f * H;
+	float y = 1.0f - 1.5f * H;
+
+	//mark the length of a 60Hz frame:
+	lines.draw(glm::vec3(bar_x + 1.0f, y + H, 0.0f), glm::vec3(bar_x + 1.0f, y - float(pass_names.size()) * 1.5f * H, 0.0f), glm::u8vec4(0xff, 0x00, 0x00, 0xff));
+
+	for (uint32_t i = 0; i < pass_names.size(); ++i) {
+		float ms = pass_latest_ms[i];
+
+		std::ostringstream label;
+		label << pass_names[i] << ' ' << std::fixed << std::setprecision(2) << std::max(ms, 0.0f);
+		lines.draw_text(label.str(),
+			glm::vec3(label_x, y, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+
+		//'filled' bar made of a few horizontal lines:
+		float len = std::min(2.0f, std::max(ms, 0.0f) * BarScale);
+		for (uint32_t l = 0; l < 4; ++l) {
+			float ly = y + 0.2f * H + l * 0.2f * H;
+			lines.draw(glm::vec3(bar_x, ly, 0.0f), glm::vec3(bar_x + len, ly, 0.0f), glm::u8vec4(0x44, 0xdd, 0x44, 0xff));
+		}
+
+		y -= 1.5f * H;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+ * GPUProfiler measures how much GPU time named passes (clear, scene, hud, ...)
+ * take, using GL_TIME_ELAPSED queries.
+ *
+ * Each frame gets its own set of queries from a small ring, and results are
+ * only read back once the GPU reports them available (a couple of frames
+ * later) -- so profiling never stalls waiting on the GPU.
+ *
+ * Usage:
+ *  //in the main loop:
+ *  gpu_profiler.begin_frame();
+ *  Mode::current->draw(drawable_size);
+ *  gpu_profiler.draw_overlay(drawable_size); //(does nothing unless show_overlay is set)
+ *  gpu_profiler.end_frame();
+ *
+ *  //in a draw function:
+ *  { GPUProfiler::Pass pass("scene");
+ *    scene.draw(*camera);
+ *  }
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct GPUProfiler {
+	//mark frame boundaries (passes outside a frame are ignored):
+	void begin_frame();
+	void end_frame();
+
+	//time everything between begin() and end() as the named pass:
+	// NOTE: passes may not nest (only one GL_TIME_ELAPSED query can be active at a time)
+	void begin(std::string const &name);
+	void end();
+
+	//RAII helper for begin()/end():
+	struct Pass {
+		Pass(std::string const &name);
+		~Pass();
+	};
+
+	//most recent result for a pass (in milliseconds), or a negative value if it hasn't been measured yet:
+	float latest_ms(std::string const &name) const;
+
+	//draw a bar for each pass in the top-left corner of the screen:
+	bool show_overlay = false;
+	void draw_overlay(glm::uvec2 const &drawable_size) const;
+
+	//write every measured pass as a "frame,pass,gpu_ms" line to a CSV file:
+	// (throws if the file can't be opened)
+	void start_csv(std::string const &filename);
+
+	//--- internals ---
+	enum : uint32_t {
+		FramesInFlight = 3, //size of the query ring; results are read back this many frames later
+		MaxPasses = 16 //per frame
+	};
+	struct Frame {
+		uint64_t number = 0;
+		bool pending = false; //has queries whose results haven't been read back
+		uint32_t used = 0;
+		GLuint queries[MaxPasses];
+		uint32_t passes[MaxPasses]; //indices into pass_names
+	};
+	Frame frames[FramesInFlight];
+	bool initialized = false; //queries are created on first use, since this lives at global scope
+
+	uint64_t frame_number = 0;
+	bool in_frame = false;
+	bool in_pass = false;
+
+	std::vector< std::string > pass_names;
+	std::vector< float > pass_latest_ms; //parallel to pass_names
+
+	std::ofstream csv;
+
+	uint32_t pass_index(std::string const &name);
+	void collect(Frame &frame); //read back results if available (does not wait)
+};
+
+extern GPUProfiler gpu_profiler;
@@ -0,0 +1,184 @@
+#include "HotReload.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+HotReload hot_reload;
+
+HotReload::HotReload() {
+}
+
+HotReload::~HotReload() {
+	finish();
+}
+
+void HotReload::watch(std::string const &filename, std::function< std::function< void() >() > const &rebuild) {
+	std::filesystem::path path(filename);
+	Watch watch;
+	watch.filename = filename;
+	watch.directory = path.parent_path().string();
+	if (watch.directory.empty()) watch.directory = ".";
+	watch.name = path.filename().string();
+	watch.rebuild = rebuild;
+	std::error_code ec;
+	watch.modified = std::filesystem::last_write_time(path, ec);
+	watches.emplace_back(watch);
+
+	if (started && inotify_fd != -1) add_directory(watches.back().directory);
+}
+
+void HotReload::start_watching() {
+	started = true;
+#if defined(__linux__)
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd == -1) {
+		std::cerr << "NOTE: inotify unavailable (" << std::strerror(errno) << "); checking asset modification times instead." << std::endl;
+	}
+	if (inotify_fd != -1) {
+		for (auto const &watch : watches) {
+			add_directory(watch.directory);
+		}
+	}
+#endif
+	polled_at = Clock::now();
+	std::cout << "Watching " << watches.size() << " asset file(s) for changes." << std::endl;
+}
+
+void HotReload::add_directory(std::string const &directory) {
+#if defined(__linux__)
+	for (auto const &[wd, dir] : watched_directories) {
+		if (dir == directory) return;
+	}
+	//watch the directory rather than the file, since exporters often replace files rather than rewriting them:
+	int wd = inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd == -1) {
+		std::cerr << "WARNING: can't watch '" << directory << "' for changes (" << std::strerror(errno) << ")." << std::endl;
+		return;
+	}
+	watched_directories.emplace_back(wd, directory);
+#else
+	(void)directory;
+#endif
+}
+
+void HotReload::read_events() {
+#if defined(__linux__)
+	alignas(inotify_event) char buffer[4096];
+	while (true) {
+		ssize_t got = read(inotify_fd, buffer, sizeof(buffer));
+		if (got <= 0) break; //(EAGAIN => nothing more queued)
+		for (char const *at = buffer; at < buffer + got; ) {
+			inotify_event const &event = *reinterpret_cast< inotify_event const * >(at);
+			at += sizeof(inotify_event) + event.len;
+			if (event.len == 0) continue;
+			std::string name(event.name); //(name is null-padded)
+			for (auto const &[wd, dir] : watched_directories) {
+				if (wd != event.wd) continue;
+				for (auto &watch : watches) {
+					if (watch.directory == dir && watch.name == name) {
+						watch.changed = true;
+						watch.changed_at = Clock::now();
+					}
+				}
+			}
+		}
+	}
+#endif
+}
+
+void HotReload::poll() {
+	for (auto &watch : watches) {
+		std::error_code ec;
+		auto modified = std::filesystem::last_write_time(watch.filename, ec);
+		if (ec) continue; //(probably mid-replace; try again next poll)
+		if (modified != watch.modified) {
+			watch.modified = modified;
+			watch.changed = true;
+			watch.changed_at = Clock::now();
+		}
+	}
+}
+
+void HotReload::update() {
+	if (!enabled || watches.empty()) return;
+	if (!started) start_watching();
+
+	Clock::time_point now = Clock::now();
+	if (inotify_fd != -1) {
+		read_events();
+	} else if (now - polled_at >= std::chrono::milliseconds(PollMs)) {
+		polled_at = now;
+		poll();
+	}
+
+	//swap in a finished rebuild:
+	if (job && job->done.load()) {
+		Watch const &watch = watches[job->watch];
+		if (job->swap) {
+			try {
+				job->swap();
+				float ms = std::chrono::duration< float, std::milli >(Clock::now() - job->started).count();
+				std::cout << "Reloaded '" << watch.filename << "' in " << ms << " ms." << std::endl;
+			} catch (std::exception &e) {
+				std::cerr << "ERROR swapping in reloaded '" << watch.filename << "': " << e.what() << std::endl;
+			}
+		} else {
+			std::cerr << "ERROR reloading '" << watch.filename << "' (keeping the previous version): " << job->error << std::endl;
+		}
+		job.reset();
+	}
+
+	//start the next rebuild (oldest change first) once its file has settled:
+	if (!job) {
+		Watch *next = nullptr;
+		for (auto &watch : watches) {
+			if (!watch.changed || now - watch.changed_at < std::chrono::milliseconds(SettleMs)) continue;
+			if (!next || watch.changed_at < next->changed_at) next = &watch;
+		}
+		if (next) {
+			next->changed = false;
+			job = std::make_shared< Job >();
+			job->watch = uint32_t(next - &watches[0]);
+			job->started = now;
+			std::shared_ptr< Job > running = job;
+			auto rebuild = next->rebuild;
+			ThreadPool::shared().run([running, rebuild]() {
+				try {
+					running->swap = rebuild();
+				} catch (std::exception &e) {
+					running->error = e.what();
+				} catch (...) {
+					running->error = "unknown exception";
+				}
+				running->done = true;
+			});
+		}
+	}
+}
+
+void HotReload::finish() {
+	while (job && !job->done.load()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	job.reset(); //(drops the rebuilt data, if any)
+
+#if defined(__linux__)
+	if (inotify_fd != -1) {
+		close(inotify_fd);
+		inotify_fd = -1;
+	}
+#endif
+	watched_directories.clear();
+	started = false;
+	enabled = false;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+ * HotReload watches asset files and rebuilds whatever was loaded from them
+ * when they change (e.g., when a .blend is re-exported), without restarting.
+ *
+ * Each watched file has a rebuild function, split into stages like a
+ * two-stage Load< T > (see Load.hpp): the first stage runs on a worker
+ * thread and returns a second stage, which update() runs on the main thread
+ * between frames to swap the new data in (GL uploads, replacing buffers).
+ *
+ * Only one rebuild runs at a time, and swaps only happen while no rebuild is
+ * running, so a rebuild may safely read data that another file's swap replaces.
+ * If a rebuild throws (say, the exporter is still writing the file), the error
+ * is printed and the old data stays in use; the next change tries again.
+ *
+ * Changes are noticed with inotify on Linux, and by checking modification times
+ * a few times a second elsewhere.
+ *
+ * Usage:
+ *  //once the data has been loaded (e.g., in a Load's GL stage):
+ *  hot_reload.watch(data_path("level.pnct"), [buffer]() {
+ *      auto fresh = std::make_shared< MeshBuffer >(data_path("level.pnct"), MeshBuffer::DeferUpload);
+ *      return [buffer, fresh]() {
+ *          fresh->upload();
+ *          buffer->replace_with(*fresh);
+ *      };
+ *  });
+ *
+ *  //at startup, to turn watching on:
+ *  hot_reload.enabled = true;
+ *
+ *  //in the main loop, before update()/draw():
+ *  hot_reload.update();
+ *
+ *  //before destroying the GL context:
+ *  hot_reload.finish();
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct HotReload {
+	HotReload();
+	~HotReload();
+
+	//files are only checked for changes when enabled (watches can be added either way):
+	bool enabled = false;
+
+	//when 'filename' changes, run 'rebuild' on a worker thread; it returns a function for update() to run on the main thread:
+	void watch(std::string const &filename, std::function< std::function< void() >() > const &rebuild);
+
+	//check for changes, start a rebuild if one is due, and swap in a finished one:
+	// (call once per frame, from the main thread, outside of drawing)
+	void update();
+
+	//wait for a running rebuild (without swapping it in) and stop watching:
+	void finish();
+
+	//--- internals ---
+	using Clock = std::chrono::steady_clock;
+
+	struct Watch {
+		std::string filename;
+		std::string directory, name; //(split, for matching inotify events)
+		std::function< std::function< void() >() > rebuild;
+		bool changed = false; //rebuild once 'changed_at' is far enough in the past
+		Clock::time_point changed_at;
+		std::filesystem::file_time_type modified; //(for the polling fallback)
+	};
+	std::vector< Watch > watches;
+
+	//the rebuild in progress, shared with the worker running it:
+	struct Job {
+		uint32_t watch = 0; //index in 'watches'
+		Clock::time_point started;
+		std::function< void() > swap; //set by the worker on success
+		std::string error; //...or this, on failure
+		std::atomic< bool > done{false};
+	};
+	std::shared_ptr< Job > job;
+
+	enum : uint32_t {
+		SettleMs = 100, //wait this long after the last change before rebuilding (exporters may write in several steps)
+		PollMs = 250, //how often to check modification times when inotify isn't available
+	};
+
+	bool started = false; //has start_watching() run?
+	int inotify_fd = -1; //(Linux only; -1 => polling)
+	std::vector< std::pair< int, std::string > > watched_directories; //inotify watch descriptor -> directory
+	Clock::time_point polled_at;
+
+	void start_watching(); //set up inotify (or the polling fallback) for everything in 'watches'
+	void add_directory(std::string const &directory); //(inotify)
+	void read_events(); //mark watches changed by queued inotify events
+	void poll(); //mark watches whose modification time changed
+};
+
+extern HotReload hot_reload;
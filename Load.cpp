@@ -1,20 +1,62 @@
 #include "Load.hpp"
 
+#include "ThreadPool.hpp"
+
+#include <algorithm>
 #include <array>
-#include <list>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 namespace {
-	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
-		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
-		return load_lists;
+	struct LoadEntry {
+		LoadTag tag = LoadTagDefault;
+		LoadBase const *self = nullptr;
+		LoadAfter after;
+
+		std::function< void() > main_fn; //single-stage load (runs on the main thread)
+		std::function< std::function< void() >() > cpu_fn; //two-stage load (CPU stage; returns GL stage)
+
+		//used while loading:
+		enum State {
+			Waiting, //for dependencies
+			Working, //CPU stage running on a worker
+			Ready, //CPU stage finished; GL stage in gl_fn
+			Done,
+		} state = Waiting;
+		std::vector< uint32_t > deps; //indices of entries this one waits for
+		std::function< void() > gl_fn;
+		std::exception_ptr error;
+	};
+
+	//(registration order; single-stage loads with the same tag run in this order)
+	std::vector< LoadEntry > &get_load_entries() {
+		static std::vector< LoadEntry > load_entries;
+		return load_entries;
 	}
 }
 
-void add_load_function(LoadTag tag, std::function< void() > const &fn) {
-	auto &load_lists = get_load_lists();
-	assert(tag < load_lists.size());
-	load_lists[tag].emplace_back(fn);
+void add_load_function(LoadTag tag, std::function< void() > const &fn, LoadBase const *self) {
+	assert(tag < MaxLoadTag);
+	LoadEntry entry;
+	entry.tag = tag;
+	entry.self = self;
+	entry.main_fn = fn;
+	get_load_entries().emplace_back(entry);
+}
+
+void add_load_stages(LoadTag tag, LoadBase const *self, LoadAfter const &after, std::function< std::function< void() >() > const &cpu) {
+	assert(tag < MaxLoadTag);
+	LoadEntry entry;
+	entry.tag = tag;
+	entry.self = self;
+	entry.after = after;
+	entry.cpu_fn = cpu;
+	get_load_entries().emplace_back(entry);
 }
 
 void call_load_functions() {
@@ -22,11 +64,268 @@ void call_load_functions() {
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
 
-	auto &load_lists = get_load_lists();
-	for (auto &fn_list : load_lists) {
-		while (!fn_list.empty()) {
-			(*fn_list.begin())(); //call first function in the list
-			fn_list.pop_front(); //remove from list
+	auto before = std::chrono::high_resolution_clock::now();
+
+	auto &entries = get_load_entries();
+
+	//resolve 'after' lists:
+	// (done here rather than at registration, since globals in other files may not have been constructed yet)
+	std::unordered_map< LoadBase const *, uint32_t > by_self;
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		if (entries[i].self) by_self.emplace(entries[i].self, i);
+	}
+	for (auto &entry : entries) {
+		for (LoadBase const *dep : entry.after) {
+			auto f = by_self.find(dep);
+			if (f == by_self.end()) {
+				throw std::runtime_error("A two-stage load lists something that isn't a Load<> in its 'after' list.");
+			}
+			entry.deps.emplace_back(f->second);
+		}
+	}
+
+	//single-stage loads also wait for the previous single-stage load with the same tag:
+	{
+		std::array< uint32_t, MaxLoadTag > previous;
+		previous.fill(-1U);
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			if (!entries[i].main_fn) continue;
+			if (previous[entries[i].tag] != -1U) entries[i].deps.emplace_back(previous[entries[i].tag]);
+			previous[entries[i].tag] = i;
+		}
+	}
+
+	//loads that haven't finished, by tag:
+	std::array< uint32_t, MaxLoadTag > remaining;
+	remaining.fill(0);
+	for (auto const &entry : entries) {
+		remaining[entry.tag] += 1;
+	}
+	auto earlier_tags_done = [&](LoadTag tag) {
+		for (uint32_t t = 0; t < tag; ++t) {
+			if (remaining[t]) return false;
+		}
+		return true;
+	};
+	auto deps_done = [&](LoadEntry const &entry) {
+		for (uint32_t d : entry.deps) {
+			if (entries[d].state != LoadEntry::Done) return false;
+		}
+		return true;
+	};
+
+	//CPU stages finish on workers; everything else happens on this thread:
+	std::mutex mutex;
+	std::condition_variable finished;
+	uint32_t working = 0;
+	uint32_t done = 0;
+	uint32_t staged = 0;
+
+	std::unique_lock< std::mutex > lock(mutex);
+
+	//on error, let running CPU stages finish (they refer to the locals above) before passing it on:
+	auto fail = [&](std::exception_ptr error) {
+		finished.wait(lock, [&](){ return working == 0; });
+		std::rethrow_exception(error);
+	};
+
+	while (done < entries.size()) {
+		//start any CPU stages that can start:
+		for (auto &entry : entries) {
+			if (entry.state != LoadEntry::Waiting || !entry.cpu_fn || !deps_done(entry)) continue;
+			entry.state = LoadEntry::Working;
+			working += 1;
+			staged += 1;
+			ThreadPool::shared().run([&entry,&mutex,&finished,&working](){
+				std::function< void() > gl_fn;
+				std::exception_ptr error;
+				try {
+					gl_fn = entry.cpu_fn();
+				} catch (...) {
+					error = std::current_exception();
+				}
+				std::unique_lock< std::mutex > lock(mutex);
+				entry.gl_fn = gl_fn;
+				entry.error = error;
+				entry.state = LoadEntry::Ready;
+				working -= 1;
+				finished.notify_all();
+			});
+		}
+
+		//find the first load whose main-thread part can run:
+		LoadEntry *next = nullptr;
+		for (auto &entry : entries) {
+			if (entry.error) fail(entry.error);
+			if (!earlier_tags_done(entry.tag)) continue;
+			if ((entry.cpu_fn && entry.state == LoadEntry::Ready)
+			 || (entry.main_fn && entry.state == LoadEntry::Waiting && deps_done(entry))) {
+				next = &entry;
+				break;
+			}
+		}
+
+		if (next) {
+			lock.unlock();
+			std::exception_ptr error;
+			try {
+				if (next->main_fn) next->main_fn();
+				else if (next->gl_fn) next->gl_fn();
+			} catch (...) {
+				error = std::current_exception();
+			}
+			lock.lock();
+			if (error) fail(error);
+			next->state = LoadEntry::Done;
+			next->gl_fn = nullptr;
+			remaining[next->tag] -= 1;
+			done += 1;
+		} else if (working > 0) {
+			finished.wait(lock);
+		} else {
+			throw std::runtime_error("Loads can't make progress; check 'after' lists for cycles (or for loads waiting on later tags).");
+		}
+	}
+
+	auto after = std::chrono::high_resolution_clock::now();
+	std::cout << "Loaded " << entries.size() << " assets (" << staged << " with worker-thread stages) in "
+		<< std::chrono::duration< double, std::milli >(after - before).count() << " ms." << std::endl;
+
+	entries.clear();
+}
+
+//------------------------------------------------
+//Lazy loads:
+
+struct LazyLoadEntry {
+	std::string name;
+	std::function< std::function< void() >() > cpu_fn;
+
+	enum State {
+		Untouched,
+		Prefetching, //CPU stage running on a worker
+		Prefetched, //CPU stage done; GL stage in gl_fn
+		Loaded,
+	} state = Untouched;
+	bool prefetched = false; //was prefetch() ever called?
+	std::function< void() > gl_fn;
+	std::exception_ptr error;
+
+	double first_use = 0.0; //seconds since startup
+	double load_ms = 0.0; //main-thread time spent in lazy_load_finish() (including waiting on a prefetch)
+};
+
+namespace {
+	//lazy loads are created during static initialization, so state lives in function-local statics:
+	struct LazyLoads {
+		std::vector< LazyLoadEntry * > entries; //(never freed; they live as long as the LazyLoad<>s)
+		std::mutex mutex;
+		std::condition_variable prefetched;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	};
+	LazyLoads &get_lazy_loads() {
+		static LazyLoads lazy_loads;
+		return lazy_loads;
+	}
+}
+
+LazyLoadEntry *add_lazy_load(std::string const &name, std::function< std::function< void() >() > const &cpu) {
+	auto &lazy = get_lazy_loads();
+	LazyLoadEntry *entry = new LazyLoadEntry;
+	entry->name = name;
+	entry->cpu_fn = cpu;
+	std::unique_lock< std::mutex > lock(lazy.mutex);
+	lazy.entries.emplace_back(entry);
+	return entry;
+}
+
+void lazy_load_prefetch(LazyLoadEntry *entry) {
+	auto &lazy = get_lazy_loads();
+	std::unique_lock< std::mutex > lock(lazy.mutex);
+	if (entry->state != LazyLoadEntry::Untouched) return;
+	entry->state = LazyLoadEntry::Prefetching;
+	entry->prefetched = true;
+	ThreadPool::shared().run([entry,&lazy](){
+		std::function< void() > gl_fn;
+		std::exception_ptr error;
+		try {
+			gl_fn = entry->cpu_fn();
+		} catch (...) {
+			error = std::current_exception();
+		}
+		std::unique_lock< std::mutex > lock(lazy.mutex);
+		entry->gl_fn = gl_fn;
+		entry->error = error;
+		entry->state = LazyLoadEntry::Prefetched;
+		lazy.prefetched.notify_all();
+	});
+}
+
+void lazy_load_finish(LazyLoadEntry *entry) {
+	auto &lazy = get_lazy_loads();
+	auto before = std::chrono::high_resolution_clock::now();
+
+	std::unique_lock< std::mutex > lock(lazy.mutex);
+	if (entry->state == LazyLoadEntry::Loaded) return;
+
+	if (entry->state == LazyLoadEntry::Untouched) {
+		//not prefetched, so run the CPU stage right here:
+		entry->state = LazyLoadEntry::Prefetching;
+		lock.unlock();
+		std::function< void() > gl_fn;
+		std::exception_ptr error;
+		try {
+			gl_fn = entry->cpu_fn();
+		} catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+		entry->gl_fn = gl_fn;
+		entry->error = error;
+		entry->state = LazyLoadEntry::Prefetched;
+	} else {
+		lazy.prefetched.wait(lock, [entry](){ return entry->state == LazyLoadEntry::Prefetched; });
+	}
+
+	if (entry->error) {
+		//(leave it to be retried on next use)
+		std::exception_ptr error = entry->error;
+		entry->error = nullptr;
+		entry->state = LazyLoadEntry::Untouched;
+		std::rethrow_exception(error);
+	}
+
+	std::function< void() > gl_fn = std::move(entry->gl_fn);
+	entry->gl_fn = nullptr;
+	lock.unlock();
+
+	gl_fn();
+
+	auto after = std::chrono::high_resolution_clock::now();
+	lock.lock();
+	entry->state = LazyLoadEntry::Loaded;
+	entry->first_use = std::chrono::duration< double >(before - lazy.start).count();
+	entry->load_ms = std::chrono::duration< double, std::milli >(after - before).count();
+}
+
+void print_lazy_load_report(std::ostream &to) {
+	auto &lazy = get_lazy_loads();
+	std::unique_lock< std::mutex > lock(lazy.mutex);
+
+	uint32_t used = 0;
+	for (auto const *entry : lazy.entries) {
+		if (entry->state == LazyLoadEntry::Loaded) used += 1;
+	}
+	to << "Lazy loads: " << used << " of " << lazy.entries.size() << " used." << std::endl;
+	for (auto const *entry : lazy.entries) {
+		to << "  " << entry->name << ": ";
+		if (entry->state == LazyLoadEntry::Loaded) {
+			to << "used from " << entry->first_use << " s (" << entry->load_ms << " ms to finish loading" << (entry->prefetched ? ", prefetched" : "") << ")";
+		} else if (entry->prefetched) {
+			to << "prefetched but never used";
+		} else {
+			to << "never used";
 		}
+		to << std::endl;
 	}
 }
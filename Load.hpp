@@ -20,10 +20,41 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * Loads can also be split into two stages, so that the slow parts of different loads overlap:
+ *
+ * Load< MeshBuffer > meshes(LoadTagDefault, {&some_program}, []() {
+ *     //CPU stage: runs on a worker thread (no OpenGL calls!) once the listed loads are done:
+ *     MeshBuffer *buffer = new MeshBuffer(data_path("level.pnct"), MeshBuffer::DeferUpload);
+ *     return [buffer]() -> MeshBuffer const * {
+ *         //GL stage: runs on the main thread once the CPU stage is done and all earlier tags have loaded:
+ *         buffer->upload();
+ *         return buffer;
+ *     };
+ * });
+ *
+ * Single-stage loads run on the main thread in tag order (and in order within a tag), as before.
+ * Two-stage loads start their CPU stage as soon as the loads they list are finished, whatever their tag.
+ *
+ * A LazyLoad< T > is not loaded by call_load_functions() at all; it loads the first time it is used:
+ *
+ * LazyLoad< MeshBuffer > bonus_meshes("bonus meshes", []() {
+ *     MeshBuffer *buffer = new MeshBuffer(data_path("bonus.pnct"), MeshBuffer::DeferUpload);
+ *     return [buffer]() -> MeshBuffer const * { buffer->upload(); return buffer; };
+ * });
+ *
+ * bonus_meshes.prefetch(); //(optional) start the CPU stage on a worker thread now
+ * bonus_meshes->lookup("Gem"); //finishes loading (waiting for the prefetch, if needed) on first use
+ *
+ * Lazy loads must be first used on the main thread, after the GL context exists.
+ * print_lazy_load_report() lists which lazy loads were actually used.
  */
 
+#include <cstdint>
 #include <functional>
+#include <iosfwd>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 enum LoadTag : uint32_t {
 	LoadTagEarly,
@@ -32,9 +63,19 @@ enum LoadTag : uint32_t {
 	MaxLoadTag //<-- just used to track # of load tags
 };
 
+//Every Load<> is a LoadBase, so loads can name each other as dependencies:
+struct LoadBase { };
+using LoadAfter = std::vector< LoadBase const * >;
+
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
-void add_load_function(LoadTag tag, std::function< void() > const &fn);
+// 'self' (may be null) is how two-stage loads refer to this one in their 'after' lists
+void add_load_function(LoadTag tag, std::function< void() > const &fn, LoadBase const *self = nullptr);
+
+//Add a two-stage loading function:
+// 'cpu' runs on a worker thread once everything in 'after' has loaded, and returns the GL stage
+// the GL stage runs on the main thread once 'cpu' is done and all loads with earlier tags have run
+void add_load_stages(LoadTag tag, LoadBase const *self, LoadAfter const &after, std::function< std::function< void() >() > const &cpu);
 
 //Call all loading functions:
 // (loading functions may throw exceptions if they fail.)
@@ -47,7 +88,7 @@ template< typename T >
 T const *new_T() { return new T; }
 
 template< typename T >
-struct Load {
+struct Load : LoadBase {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
 	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
 		add_load_function(tag, [this,load_fn](){
@@ -55,6 +96,19 @@ struct Load {
 			if (!(this->value)) {
 				throw std::runtime_error("Loading failed.");
 			}
+		}, this);
+	}
+
+	//Two-stage version (see above): 'cpu_fn' returns the function that finishes loading on the main thread:
+	Load(LoadTag tag, LoadAfter const &after, const std::function< std::function< T const *() >() > &cpu_fn) : value(nullptr) {
+		add_load_stages(tag, this, after, [this,cpu_fn]() -> std::function< void() > {
+			std::function< T const *() > gl_fn = cpu_fn();
+			return [this,gl_fn](){
+				this->value = gl_fn();
+				if (!(this->value)) {
+					throw std::runtime_error("Loading failed.");
+				}
+			};
 		});
 	}
 
@@ -71,11 +125,63 @@ struct Load {
 //Specialization:
 //Load< void > just calls a function:
 template< >
-struct Load< void > {
+struct Load< void > : LoadBase {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
 	Load( LoadTag tag, const std::function< void() > &load_fn) {
-		add_load_function(tag, load_fn);
+		add_load_function(tag, load_fn, this);
 	}
 };
 
 
+//Lazy loads (see above) -- helpers used by LazyLoad< T >:
+struct LazyLoadEntry;
+LazyLoadEntry *add_lazy_load(std::string const &name, std::function< std::function< void() >() > const &cpu);
+void lazy_load_prefetch(LazyLoadEntry *entry); //start the CPU stage on a worker (if it hasn't started)
+void lazy_load_finish(LazyLoadEntry *entry); //run whatever stages haven't run yet (main thread only)
+
+//list each lazy load as used, prefetched-but-unused, or unused (with load times):
+void print_lazy_load_report(std::ostream &to);
+
+template< typename T >
+struct LazyLoad {
+	//single-stage: 'load_fn' runs on the main thread at first use:
+	LazyLoad(std::string const &name, const std::function< T const *() > &load_fn = new_T< T >) {
+		entry = add_lazy_load(name, [this,load_fn]() -> std::function< void() > {
+			return [this,load_fn](){
+				this->value = load_fn();
+				if (!(this->value)) {
+					throw std::runtime_error("Loading failed.");
+				}
+			};
+		});
+	}
+
+	//two-stage: 'cpu_fn' may run early on a worker (via prefetch()); the function it returns runs on the main thread:
+	LazyLoad(std::string const &name, const std::function< std::function< T const *() >() > &cpu_fn) {
+		entry = add_lazy_load(name, [this,cpu_fn]() -> std::function< void() > {
+			std::function< T const *() > gl_fn = cpu_fn();
+			return [this,gl_fn](){
+				this->value = gl_fn();
+				if (!(this->value)) {
+					throw std::runtime_error("Loading failed.");
+				}
+			};
+		});
+	}
+
+	void prefetch() { if (!value) lazy_load_prefetch(entry); }
+
+	T const *get() {
+		if (!value) lazy_load_finish(entry);
+		return value;
+	}
+	bool loaded() const { return value != nullptr; }
+
+	//Make a "LazyLoad< T >" behave like a "T const *":
+	operator T const *() { return get(); }
+	T const &operator*() { return *get(); }
+	T const *operator->() { return get(); }
+
+	T const *value = nullptr;
+	LazyLoadEntry *entry = nullptr;
+};
@@ -30,6 +30,7 @@ if (maek.OS === "windows") {
 		`/I${NEST_LIBS}/SDL2/include`,
 		`/I${NEST_LIBS}/glm/include`,
 		`/I${NEST_LIBS}/libpng/include`,
+		`/I${NEST_LIBS}/zlib/include`,
 		//#disable a few warnings:
 		`/wd4146`, //-1U is still unsigned
 		`/wd4297`, //unforunately SDLmain is nothrow
@@ -49,7 +50,8 @@ if (maek.OS === "windows") {
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
-		`-I${NEST_LIBS}/libpng/include`
+		`-I${NEST_LIBS}/libpng/include`,
+		`-I${NEST_LIBS}/zlib/include`
 	);
 	maek.options.LINKLibs.push(
 		//linker flags for nest libraries:
@@ -63,7 +65,8 @@ if (maek.OS === "windows") {
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
-		`-I${NEST_LIBS}/libpng/include`
+		`-I${NEST_LIBS}/libpng/include`,
+		`-I${NEST_LIBS}/zlib/include`
 	);
 	maek.options.LINKLibs.push(
 		//linker flags for nest libraries:
@@ -115,11 +118,24 @@ const common_names = [
 	maek.CPP('ColorProgram.cpp'),
 	maek.CPP('Scene.cpp'),
 	maek.CPP('Mesh.cpp'),
+	maek.CPP('MeshOptimize.cpp'),
 	maek.CPP('load_save_png.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
 	maek.CPP('Mode.cpp'),
 	maek.CPP('GL.cpp'),
-	maek.CPP('Load.cpp')
+	maek.CPP('Load.cpp'),
+	maek.CPP('ThreadPool.cpp'),
+	maek.CPP('GPUProfiler.cpp'),
+	maek.CPP('StreamBuffer.cpp'),
+	maek.CPP('ScreenCapture.cpp'),
+	maek.CPP('DynamicResolution.cpp'),
+	maek.CPP('FramePipeline.cpp'),
+	maek.CPP('MappedFile.cpp'),
+	maek.CPP('AssetPack.cpp'),
+	maek.CPP('read_write_chunk.cpp'),
+	maek.CPP('HotReload.cpp'),
+	maek.CPP('BufferUpload.cpp'),
+	maek.CPP('Texture.cpp')
 ];
 
 const show_mesh_names = [
@@ -134,6 +150,19 @@ const show_scene_names = [
 	maek.CPP('ShowSceneMode.cpp')
 ];
 
+const render_bench_names = [
+	maek.CPP('render-bench.cpp'),
+	maek.CPP('ShowSceneProgram.cpp')
+];
+
+const chunk_bench_names = [
+	maek.CPP('chunk-bench.cpp')
+];
+
+const optimize_meshes_names = [
+	maek.CPP('optimize-meshes.cpp')
+];
+
 //the '[exeFile =] LINK(objFiles, exeFileBase, [, options])' links an array of objects into an executable:
 // objFiles: array of objects to link
 // exeFileBase: name of executable file to produce
@@ -141,9 +170,12 @@ const show_scene_names = [
 const game_exe = maek.LINK([...game_names, ...common_names], 'dist/game');
 const show_meshes_exe = maek.LINK([...show_mesh_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+const render_bench_exe = maek.LINK([...render_bench_names, ...common_names], 'scenes/render-bench');
+const chunk_bench_exe = maek.LINK([...chunk_bench_names, ...common_names], 'scenes/chunk-bench');
+const optimize_meshes_exe = maek.LINK([...optimize_meshes_names, ...common_names], 'scenes/optimize-meshes');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, render_bench_exe, chunk_bench_exe, optimize_meshes_exe, ...copies];
 
 //the '[targets =] RULE(targets, prerequisites[, recipe])' rule defines a Makefile-style task
 // targets: array of targets the task produces (can include both files and ':abstract targets')
@@ -0,0 +1,113 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//(zero-length files are never mapped; they just have a null data pointer)
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	//(paths are UTF-8, so convert to wide characters for the W API)
+	int wide_length = MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, nullptr, 0);
+	std::wstring wide(wide_length > 0 ? wide_length : 1, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, &wide[0], wide_length);
+
+	HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	length = size_t(file_size.QuadPart);
+	if (length == 0) return;
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+	mapping_handle = mapping;
+
+	bytes = reinterpret_cast< uint8_t const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (bytes == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map view of '" + filename + "'.");
+	}
+}
+
+void MappedFile::release(uint8_t const *, size_t) const {
+	//(nothing to do: Windows trims clean file-backed pages from the working set as needed)
+}
+
+MappedFile::~MappedFile() {
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping_handle) CloseHandle(reinterpret_cast< HANDLE >(mapping_handle));
+	if (file_handle) CloseHandle(reinterpret_cast< HANDLE >(file_handle));
+}
+
+#else
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	length = size_t(info.st_size);
+	if (length == 0) {
+		close(fd);
+		return;
+	}
+
+	void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //(the mapping keeps the file alive)
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+	//asset files are read front to back, once, right away:
+	// (advice values aren't flags, so each takes its own call)
+	madvise(mapped, length, MADV_SEQUENTIAL);
+	madvise(mapped, length, MADV_WILLNEED);
+
+	bytes = reinterpret_cast< uint8_t const * >(mapped);
+}
+
+MappedFile::~MappedFile() {
+	if (bytes) munmap(const_cast< uint8_t * >(bytes), length);
+}
+
+void MappedFile::release(uint8_t const *begin, size_t size) const {
+	if (!bytes || begin < bytes || begin + size > bytes + length) return;
+	//only whole pages inside the range can go:
+	size_t page = size_t(sysconf(_SC_PAGESIZE));
+	uintptr_t first = (uintptr_t(begin) + page - 1) / page * page;
+	uintptr_t last = (uintptr_t(begin) + size) / page * page;
+	if (first < last) {
+		//(the mapping is private and never written, so dropped pages are simply read from the file again)
+		madvise(reinterpret_cast< void * >(first), last - first, MADV_DONTNEED);
+	}
+}
+
+#endif
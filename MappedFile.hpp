@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * MappedFile is a read-only view of a whole file, memory-mapped so that
+ * loading code can read (or hand to GL) file contents in place instead of
+ * copying them into buffers first.
+ *
+ * Mappings start at a page boundary, so data at any offset is as aligned as
+ * the file layout allows (see ChunkReader in read_write_chunk.hpp).
+ *
+ * NOTE: the constructor throws if the file can't be opened or mapped.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct MappedFile {
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	uint8_t const *data() const { return bytes; }
+	size_t size() const { return length; }
+
+	//hint that [begin, begin+size) won't be read again soon, so its pages can be dropped from memory:
+	// (the data stays readable -- it is just read from the file again if needed; ranges outside the mapping are ignored)
+	void release(uint8_t const *begin, size_t size) const;
+
+	std::string filename;
+
+	//--- internals ---
+	uint8_t const *bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#endif
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+};
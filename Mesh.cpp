@@ -1,64 +1,276 @@
 #include "Mesh.hpp"
 #include "read_write_chunk.hpp"
+#include "AssetPack.hpp"
+#include "MeshOptimize.hpp"
+#include "ThreadPool.hpp"
+#include "BufferUpload.hpp"
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <map>
 #include <set>
 #include <cstddef>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
-
-	std::ifstream file(filename, std::ios::binary);
-
-	GLuint total = 0;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_BOUNDS_SSE2
+#endif
 
-	struct Vertex {
+//Vertex formats stored in '.pnct' files:
+namespace {
+	//"pnct" (v1) -- full-precision everything, 32 bytes:
+	struct VertexPNCT {
 		glm::vec3 Position;
 		glm::vec3 Normal;
 		glm::u8vec4 Color;
 		glm::vec2 TexCoord;
 	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
+	static_assert(sizeof(VertexPNCT) == 3*4+3*4+4*1+2*4, "VertexPNCT is packed.");
 
-	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+	//"pnc2" (v2) -- 2_10_10_10 normal, half-float texcoord, 24 bytes:
+	struct VertexPNC2 {
+		glm::vec3 Position;
+		uint32_t Normal; //snorm x,y,z in 10 bits each (GL_INT_2_10_10_10_REV)
+		glm::u8vec4 Color;
+		uint32_t TexCoord; //two half floats (GL_HALF_FLOAT)
+	};
+	static_assert(sizeof(VertexPNC2) == 3*4+4+4+2*2, "VertexPNC2 is packed.");
+
+	//"pnq2" (v2, quantized) -- as above, but with 16-bit integer positions in [-32767,32767], 20 bytes:
+	// (positions are decoded with a per-mesh scale and offset, stored in a "pqd0" chunk;
+	//  they are bound as plain -- not normalized -- GL_SHORT, so the GPU and CPU decode them identically)
+	struct VertexPNQ2 {
+		glm::i16vec4 Position; //(w is padding)
+		uint32_t Normal;
+		glm::u8vec4 Color;
+		uint32_t TexCoord;
+	};
+	static_assert(sizeof(VertexPNQ2) == 4*2+4+4+2*2, "VertexPNQ2 is packed.");
+
+	//per-mesh position decoding for "pnq2" vertices (position = offset + scale * quantized, with quantized the integer value):
+	struct PositionDecode {
+		glm::vec3 scale;
+		glm::vec3 offset;
+	};
+	static_assert(sizeof(PositionDecode) == 3*4+3*4, "PositionDecode is packed.");
+
+	//per-mesh bounding box (in decoded object space), stored in an optional "bnd0" chunk:
+	struct MeshBounds {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+	static_assert(sizeof(MeshBounds) == 3*4+3*4, "MeshBounds is packed.");
+
+	//per-mesh LOD ranges (in the index chunk), stored in an optional "lod0" chunk:
+	struct MeshLODs {
+		uint32_t lod_count;
+		struct { uint32_t begin, end; } lods[Mesh::MaxLODs];
+	};
+	static_assert(sizeof(MeshLODs) == 4 + 3*2*4, "MeshLODs is packed (and matches Mesh::MaxLODs).");
+
+	//one "idx0" entry per mesh:
+	struct IndexEntry {
+		uint32_t name_begin, name_end; //(range in "str0" chunk)
+		uint32_t vertex_begin, vertex_end; //(range in index chunk, for indexed files)
+	};
+	static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+
+	enum VertexFormat { PNCT, PNC2, PNQ2 };
+	char const *format_magic(VertexFormat format) {
+		if (format == PNCT) return "pnct";
+		else if (format == PNC2) return "pnc2";
+		else return "pnq2";
+	}
+	uint32_t format_stride(VertexFormat format) {
+		if (format == PNCT) return sizeof(VertexPNCT);
+		else if (format == PNC2) return sizeof(VertexPNC2);
+		else return sizeof(VertexPNQ2);
+	}
+
+	//position of vertex v (before per-mesh decoding):
+	glm::vec3 format_position(VertexFormat format, uint8_t const *vertices, uint32_t v) {
+		uint8_t const *vertex = vertices + size_t(v) * format_stride(format);
+		if (format == PNCT) return reinterpret_cast< VertexPNCT const * >(vertex)->Position;
+		else if (format == PNC2) return reinterpret_cast< VertexPNC2 const * >(vertex)->Position;
+		else return glm::vec3(reinterpret_cast< VertexPNQ2 const * >(vertex)->Position);
+	}
+
+	//bounds of the (undecoded) positions of 'count' vertices, indices[start...] (or start... if indices is null):
+	// n.b. the SSE2 path reads 16 bytes (8 for PNQ2) from the start of each vertex, which stays within the vertex for every format
+	void format_bounds(VertexFormat format, uint8_t const *vertices, uint32_t const *indices, uint32_t start, uint32_t count, glm::vec3 *min_, glm::vec3 *max_) {
+		uint32_t stride = format_stride(format);
+		auto vertex = [&](uint32_t i) {
+			return vertices + size_t(indices ? indices[start + i] : start + i) * stride;
+		};
+	#ifdef MESH_BOUNDS_SSE2
+		__m128 min = _mm_set1_ps( std::numeric_limits< float >::infinity());
+		__m128 max = _mm_set1_ps(-std::numeric_limits< float >::infinity());
+		if (format == PNQ2) {
+			for (uint32_t i = 0; i < count; ++i) {
+				__m128i q = _mm_loadl_epi64(reinterpret_cast< __m128i const * >(vertex(i)));
+				__m128 p = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(q, q), 16)); //(sign-extend to 32 bits)
+				min = _mm_min_ps(min, p);
+				max = _mm_max_ps(max, p);
+			}
+		} else {
+			for (uint32_t i = 0; i < count; ++i) {
+				__m128 p = _mm_loadu_ps(reinterpret_cast< float const * >(vertex(i))); //(w lane holds part of the normal; ignored)
+				min = _mm_min_ps(min, p);
+				max = _mm_max_ps(max, p);
+			}
+		}
+		alignas(16) float lo[4], hi[4];
+		_mm_store_ps(lo, min);
+		_mm_store_ps(hi, max);
+		*min_ = glm::vec3(lo[0], lo[1], lo[2]);
+		*max_ = glm::vec3(hi[0], hi[1], hi[2]);
+	#else
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+		if (format == PNQ2) {
+			for (uint32_t i = 0; i < count; ++i) {
+				glm::vec3 p = glm::vec3(reinterpret_cast< VertexPNQ2 const * >(vertex(i))->Position);
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+		} else {
+			for (uint32_t i = 0; i < count; ++i) {
+				glm::vec3 p;
+				std::memcpy(&p, vertex(i), sizeof(p)); //(position is first in both float formats)
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+		}
+		*min_ = min;
+		*max_ = max;
+	#endif
+	}
+
+	//normal of vertex v:
+	glm::vec3 format_normal(VertexFormat format, uint8_t const *vertices, uint32_t v) {
+		uint8_t const *vertex = vertices + size_t(v) * format_stride(format);
+		if (format == PNCT) return reinterpret_cast< VertexPNCT const * >(vertex)->Normal;
+		else if (format == PNC2) return glm::vec3(glm::unpackSnorm3x10_1x2(reinterpret_cast< VertexPNC2 const * >(vertex)->Normal));
+		else return glm::vec3(glm::unpackSnorm3x10_1x2(reinterpret_cast< VertexPNQ2 const * >(vertex)->Normal));
+	}
+}
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+struct MeshBuffer::Pending {
+	Pending(std::string const &filename) : mapped(filename), file(mapped.data(), mapped.size(), filename) { }
 
-		total = GLuint(data.size()); //store total for later checks on index
+	//chunks are read in place from the mapped file (or pack):
+	AssetFile mapped;
+	ChunkReader file;
 
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+	//vertex data, as bytes in one of the formats above:
+	// (a view of the file until some step of loading rewrites it into 'vertex_storage')
+	ChunkSpan< uint8_t > vertices;
+	std::vector< uint8_t > vertex_storage;
+
+	//indices (if the file contains them or they are built by OptimizeIndices):
+	// (as above, a view of the file or of 'index_storage')
+	ChunkSpan< uint32_t > indices;
+	std::vector< uint32_t > index_storage;
+	bool indexed = false;
+
+	VertexFormat format = PNCT; //(of 'vertices')
+};
+
+MeshBuffer::MeshBuffer(std::string const &filename, uint32_t flags) : pending(new Pending(filename)) {
+	ChunkReader &file = pending->file;
+	VertexFormat &format = pending->format;
+	ChunkSpan< uint8_t > &vertices = pending->vertices;
+	std::vector< uint8_t > &vertex_storage = pending->vertex_storage;
+	ChunkSpan< uint32_t > &indices = pending->indices;
+	std::vector< uint32_t > &index_storage = pending->index_storage;
+	bool &indexed = pending->indexed;
+
+	//read data chunk(s):
+	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
+		//vertex chunk may be in any of the supported formats:
+		if (file.peek("pnct")) format = PNCT;
+		else if (file.peek("pnc2")) format = PNC2;
+		else if (file.peek("pnq2")) format = PNQ2;
+		else throw std::runtime_error("Mesh file '" + filename + "' doesn't start with a known vertex chunk");
+
+		vertices = file.read< uint8_t >(format_magic(format));
+		if (vertices.size() % format_stride(format) != 0) {
+			throw std::runtime_error("Size of vertex chunk not divisible by vertex size");
+		}
+
+		//(optional) index chunk; if present, all meshes are drawn with indices:
+		if (file.peek("ind0")) {
+			indices = file.read< uint32_t >("ind0");
+			for (uint32_t i : indices) {
+				if (i >= vertices.size() / format_stride(format)) {
+					throw std::runtime_error("index chunk references out-of-range vertex");
+				}
+			}
+			indexed = true;
+		}
 	} else {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	//for later checks on index entries:
+	GLuint total = GLuint(indexed ? indices.size() : vertices.size() / format_stride(format));
+
+	ChunkSpan< char > strings = file.read< char >("str0");
+
+	bool have_bounds = false; //(set if the file has a bounds chunk)
+	bool have_lods = false; //(set if the file has a LOD chunk)
 
 	{ //read index chunk, add to meshes:
-		struct IndexEntry {
-			uint32_t name_begin, name_end;
-			uint32_t vertex_begin, vertex_end;
-		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+		ChunkSpan< IndexEntry > index = file.read< IndexEntry >("idx0");
+
+		//quantized positions come with decoding information for each index entry:
+		ChunkSpan< PositionDecode > decode;
+		if (format == PNQ2) {
+			decode = file.read< PositionDecode >("pqd0");
+			if (decode.size() != index.size()) {
+				throw std::runtime_error("position decoding chunk doesn't match index chunk");
+			}
+		}
+
+		//(optional) precomputed bounds for each index entry:
+		ChunkSpan< MeshBounds > bounds;
+		if (file.peek("bnd0")) {
+			bounds = file.read< MeshBounds >("bnd0");
+			if (bounds.size() != index.size()) {
+				throw std::runtime_error("bounds chunk doesn't match index chunk");
+			}
+			have_bounds = true;
+		}
+
+		//(optional) precomputed LODs for each index entry:
+		ChunkSpan< MeshLODs > lods;
+		if (file.peek("lod0")) {
+			lods = file.read< MeshLODs >("lod0");
+			if (lods.size() != index.size()) {
+				throw std::runtime_error("LOD chunk doesn't match index chunk");
+			}
+			if (!indexed) {
+				throw std::runtime_error("LOD chunk in a file without an index chunk");
+			}
+			have_lods = true;
+		}
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		//names are kept (the file is unmapped after upload), and looked up through 'table':
+		names.assign(strings.begin(), strings.end());
+		uint32_t table_size = 16;
+		while (table_size < 2 * index.size()) table_size *= 2;
+		table.assign(table_size, InvalidMeshID);
+		meshes.reserve(index.size());
+		name_ranges.reserve(index.size());
 
 		for (auto const &entry : index) {
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
@@ -67,46 +279,506 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
+			std::string_view name(names.data() + entry.name_begin, entry.name_end - entry.name_begin);
+			//a repeated name is still loaded (so ids stay file positions) but isn't added to 'table', so lookups find the first:
+			bool duplicate = (find(name) != InvalidMeshID);
+			if (duplicate) {
+				std::cerr << "WARNING: mesh name '" << name << "' in filename '" << filename << "' collides with existing mesh; lookups will use the first." << std::endl;
+			}
 			Mesh mesh;
 			mesh.type = GL_TRIANGLES;
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
-			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
-				mesh.min = glm::min(mesh.min, data[v].Position);
-				mesh.max = glm::max(mesh.max, data[v].Position);
+			mesh.index_type = (indexed ? GL_UNSIGNED_INT : 0);
+			if (!decode.empty()) {
+				mesh.position_scale = decode[&entry - &index[0]].scale;
+				mesh.position_offset = decode[&entry - &index[0]].offset;
+			}
+			if (!bounds.empty()) {
+				mesh.min = bounds[&entry - &index[0]].min;
+				mesh.max = bounds[&entry - &index[0]].max;
 			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			if (!lods.empty()) {
+				MeshLODs const &from = lods[&entry - &index[0]];
+				if (from.lod_count > Mesh::MaxLODs) {
+					throw std::runtime_error("LOD entry has too many levels");
+				}
+				for (uint32_t l = 0; l < from.lod_count; ++l) {
+					if (!(from.lods[l].begin <= from.lods[l].end && from.lods[l].end <= total)) {
+						throw std::runtime_error("LOD entry has out-of-range start/count");
+					}
+					mesh.lods[l].start = from.lods[l].begin;
+					mesh.lods[l].count = from.lods[l].end - from.lods[l].begin;
+				}
+				mesh.lod_count = from.lod_count;
 			}
+			MeshID id = MeshID(meshes.size());
+			meshes.emplace_back(mesh);
+			name_ranges.emplace_back(entry.name_begin, entry.name_end);
+			if (!duplicate) add_name(id, fnv1a64(reinterpret_cast< uint8_t const * >(name.data()), name.size()));
 		}
 	}
 
-	if (file.peek() != EOF) {
+	if (!file.at_end()) {
 		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
 
+	//compact full-precision vertices (quantized positions start from compact vertices):
+	if (format == PNCT && (flags & (CompactVertices | QuantizePositions))) {
+		uint32_t count = uint32_t(vertices.size() / sizeof(VertexPNCT));
+		std::vector< uint8_t > compact(size_t(count) * sizeof(VertexPNC2));
+		for (uint32_t v = 0; v < count; ++v) {
+			VertexPNCT const &from = reinterpret_cast< VertexPNCT const * >(vertices.data())[v];
+			VertexPNC2 &to = reinterpret_cast< VertexPNC2 * >(compact.data())[v];
+			to.Position = from.Position;
+			to.Normal = glm::packSnorm3x10_1x2(glm::vec4(from.Normal, 0.0f));
+			to.Color = from.Color;
+			to.TexCoord = glm::packHalf2x16(from.TexCoord);
+		}
+		vertex_storage = std::move(compact);
+		vertices = ChunkSpan< uint8_t >(vertex_storage);
+		format = PNC2;
+	}
+
+	uint32_t stride = format_stride(format);
+
+	if (flags & OptimizeIndices) {
+		//Each mesh gets its own vertex range, so meshes never share vertices
+		// (which keeps per-mesh position quantization valid);
+		// meshes that name exactly the same range share the optimized result:
+		std::map< std::pair< GLuint, GLuint >, std::pair< GLuint, GLuint > > done;
+
+		std::vector< uint8_t > new_vertices;
+		std::vector< uint32_t > new_indices;
+		uint32_t old_count = uint32_t(vertices.size() / stride);
+		float misses_before = 0.0f;
+		float misses_after = 0.0f;
+		for (auto &mesh : meshes) {
+			auto key = std::make_pair(mesh.start, mesh.count);
+			auto f = done.find(key);
+			if (f == done.end()) {
+				uint32_t count = mesh.count / 3 * 3; //(whole triangles only)
+
+				//gather this mesh's vertices in drawing order:
+				std::vector< uint32_t > original(count);
+				for (uint32_t i = 0; i < count; ++i) {
+					original[i] = (indexed ? indices[mesh.start + i] : mesh.start + i);
+				}
+				misses_before += compute_acmr(original.data(), count) * (count / 3);
+
+				std::vector< uint8_t > soup(size_t(count) * stride);
+				for (uint32_t i = 0; i < count; ++i) {
+					std::memcpy(&soup[size_t(i) * stride], &vertices[size_t(original[i]) * stride], stride);
+				}
+
+				//merge identical vertices:
+				std::vector< uint32_t > local;
+				uint32_t unique = dedup_vertices(soup.data(), stride, count, &local);
+				std::vector< uint32_t > unique_to_soup(unique, -1U);
+				for (uint32_t i = count; i > 0; --i) {
+					unique_to_soup[local[i-1]] = i-1; //(ends up pointing to the first copy)
+				}
+
+				//reorder triangles for the post-transform cache:
+				optimize_vertex_cache(local.data(), count, unique);
+				misses_after += compute_acmr(local.data(), count) * (count / 3);
+
+				//...and store vertices in the order they are first used:
+				std::vector< uint32_t > new_to_unique;
+				optimize_vertex_fetch(local.data(), count, unique, &new_to_unique);
+
+				uint32_t base = uint32_t(new_vertices.size() / stride);
+				for (uint32_t u : new_to_unique) {
+					uint8_t const *vertex = &soup[size_t(unique_to_soup[u]) * stride];
+					new_vertices.insert(new_vertices.end(), vertex, vertex + stride);
+				}
+				GLuint begin = GLuint(new_indices.size());
+				for (uint32_t i : local) {
+					new_indices.emplace_back(base + i);
+				}
+				f = done.emplace(key, std::make_pair(begin, GLuint(count))).first;
+			}
+			mesh.start = f->second.first;
+			mesh.count = f->second.second;
+			mesh.index_type = GL_UNSIGNED_INT;
+		}
+
+		if (flags & PrintStats) {
+			uint32_t triangles = uint32_t(new_indices.size() / 3);
+			std::cout << "MeshBuffer '" << filename << "': " << old_count << " -> " << new_vertices.size() / stride << " vertices;"
+				<< " ACMR " << (triangles ? misses_before / triangles : 0.0f) << " -> " << (triangles ? misses_after / triangles : 0.0f) << std::endl;
+		}
+
+		vertex_storage = std::move(new_vertices);
+		vertices = ChunkSpan< uint8_t >(vertex_storage);
+		index_storage = std::move(new_indices);
+		indices = ChunkSpan< uint32_t >(index_storage);
+		indexed = true;
+
+		//(any LODs from the file were ranges in the old indices)
+		if (have_lods) {
+			for (auto &mesh : meshes) {
+				mesh.lod_count = 0;
+			}
+			have_lods = false;
+		}
+	}
+
+	//(files that come with LODs -- e.g., from scenes/optimize-meshes --lods -- don't need new ones)
+	if ((flags & GenerateLODs) && !have_lods) {
+		//LOD indices are appended, so the indices need to be in (growable) storage:
+		if (indexed && index_storage.data() != indices.data()) {
+			index_storage.assign(indices.begin(), indices.end());
+		}
+		//simplification needs index lists, so unindexed meshes use the identity mapping:
+		if (!indexed) {
+			index_storage.resize(vertices.size() / stride);
+			for (uint32_t i = 0; i < uint32_t(index_storage.size()); ++i) {
+				index_storage[i] = i;
+			}
+			for (auto &mesh : meshes) {
+				mesh.index_type = GL_UNSIGNED_INT;
+			}
+			indexed = true;
+		}
+
+		//positions and normals, for the simplifier:
+		uint32_t count = uint32_t(vertices.size() / stride);
+		std::vector< glm::vec3 > positions(count);
+		std::vector< glm::vec3 > normals(count);
+		for (uint32_t v = 0; v < count; ++v) {
+			positions[v] = format_position(format, vertices.data(), v);
+			normals[v] = format_normal(format, vertices.data(), v);
+		}
+
+		//each level aims for half the triangles of the one before; stop when that stops paying off:
+		constexpr uint32_t MinTriangles = 32;
+		std::map< std::pair< GLuint, GLuint >, Mesh > done; //(meshes naming the same range share LODs)
+		uint32_t levels = 0;
+		for (auto &mesh : meshes) {
+			if (mesh.type != GL_TRIANGLES) continue;
+			auto key = std::make_pair(mesh.start, mesh.count);
+			auto f = done.find(key);
+			if (f == done.end()) {
+				Mesh lods = mesh;
+				lods.lod_count = 0;
+				std::vector< uint32_t > level(index_storage.begin() + mesh.start, index_storage.begin() + mesh.start + mesh.count / 3 * 3);
+
+				//simplify within the vertices this mesh uses (indices are rebased to the start of that range):
+				uint32_t lo = -1U, hi = 0;
+				for (uint32_t i : level) {
+					lo = std::min(lo, i);
+					hi = std::max(hi, i + 1);
+				}
+				for (uint32_t &i : level) i -= lo;
+
+				while (lods.lod_count < Mesh::MaxLODs && level.size() / 3 >= 2 * MinTriangles) {
+					std::vector< uint32_t > simpler;
+					simplify_mesh(level.data(), uint32_t(level.size()),
+						&positions[lo].x, &normals[lo].x, hi - lo,
+						uint32_t(level.size() / 2), &simpler);
+					if (simpler.size() > level.size() * 3 / 4) break; //(hit borders or flips; not worth another level)
+					lods.lods[lods.lod_count].start = GLuint(index_storage.size());
+					lods.lods[lods.lod_count].count = GLuint(simpler.size());
+					lods.lod_count += 1;
+					for (uint32_t i : simpler) {
+						index_storage.emplace_back(i + lo);
+					}
+					level = std::move(simpler);
+				}
+				f = done.emplace(key, lods).first;
+				levels += lods.lod_count;
+			}
+			std::copy(f->second.lods, f->second.lods + Mesh::MaxLODs, mesh.lods);
+			mesh.lod_count = f->second.lod_count;
+		}
+		if (flags & PrintStats) {
+			std::cout << "MeshBuffer '" << filename << "': generated " << levels << " LOD levels for " << done.size() << " meshes." << std::endl;
+		}
+		indices = ChunkSpan< uint32_t >(index_storage);
+	}
+
+	//vertex range used by a mesh:
+	auto vertex_range = [&](Mesh const &mesh) -> std::pair< uint32_t, uint32_t > {
+		if (mesh.count == 0) return std::make_pair(0U, 0U);
+		if (mesh.index_type == 0) return std::make_pair(mesh.start, mesh.start + mesh.count);
+		uint32_t lo = -1U, hi = 0;
+		for (uint32_t i = mesh.start; i < mesh.start + mesh.count; ++i) {
+			lo = std::min(lo, indices[i]);
+			hi = std::max(hi, indices[i] + 1);
+		}
+		return std::make_pair(lo, hi);
+	};
+
+	if ((flags & QuantizePositions) && format == PNC2) {
+		//each mesh's positions are stored relative to its own bounding box, so meshes may not share vertices:
+		std::map< std::pair< uint32_t, uint32_t >, std::vector< Mesh * > > ranges;
+		for (auto &mesh : meshes) {
+			auto range = vertex_range(mesh);
+			if (range.first < range.second) ranges[range].emplace_back(&mesh);
+		}
+		bool disjoint = true;
+		uint32_t previous_end = 0;
+		for (auto const &[range, users] : ranges) {
+			if (range.first < previous_end) disjoint = false;
+			previous_end = range.second;
+		}
+
+		if (!disjoint) {
+			std::cerr << "WARNING: meshes in '" << filename << "' share vertices, so positions will not be quantized (try OptimizeIndices)." << std::endl;
+		} else {
+			uint32_t count = uint32_t(vertices.size() / sizeof(VertexPNC2));
+			VertexPNC2 const *from = reinterpret_cast< VertexPNC2 const * >(vertices.data());
+			std::vector< uint8_t > quantized(size_t(count) * sizeof(VertexPNQ2), 0); //(vertices not used by any mesh end up at the origin)
+			VertexPNQ2 *to = reinterpret_cast< VertexPNQ2 * >(quantized.data());
+			for (uint32_t v = 0; v < count; ++v) {
+				to[v].Normal = from[v].Normal;
+				to[v].Color = from[v].Color;
+				to[v].TexCoord = from[v].TexCoord;
+			}
+			for (auto const &[range, users] : ranges) {
+				glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+				for (uint32_t v = range.first; v < range.second; ++v) {
+					min = glm::min(min, from[v].Position);
+					max = glm::max(max, from[v].Position);
+				}
+				glm::vec3 offset = 0.5f * (max + min);
+				glm::vec3 scale = 0.5f * (max - min);
+				//(flat axes still need a non-zero scale to decode properly)
+				scale = glm::max(scale, glm::vec3(1e-6f));
+				for (uint32_t v = range.first; v < range.second; ++v) {
+					glm::vec3 q = glm::clamp((from[v].Position - offset) / scale, glm::vec3(-1.0f), glm::vec3(1.0f));
+					to[v].Position = glm::i16vec4(glm::i16vec3(glm::round(q * 32767.0f)), int16_t(0));
+				}
+				for (Mesh *mesh : users) {
+					mesh->position_scale = scale / 32767.0f; //(for the integer values, as the GPU sees them)
+					mesh->position_offset = offset;
+				}
+			}
+			vertex_storage = std::move(quantized);
+			vertices = ChunkSpan< uint8_t >(vertex_storage);
+			format = PNQ2;
+			stride = format_stride(format);
+		}
+	}
+
+	//compute bounding boxes (in decoded object space), unless the file had them:
+	// (none of the steps above move vertices in object space; quantization maps each mesh's bounds to exactly -32767 and 32767)
+	if (!have_bounds) {
+		std::vector< Mesh * > todo;
+		uint64_t work = 0;
+		for (auto &mesh : meshes) {
+			todo.emplace_back(&mesh);
+			work += mesh.count;
+		}
+		auto compute = [&](uint32_t begin, uint32_t end) {
+			for (uint32_t m = begin; m < end; ++m) {
+				Mesh &mesh = *todo[m];
+				if (mesh.count == 0) continue;
+				glm::vec3 min, max;
+				format_bounds(format, vertices.data(), (mesh.index_type ? indices.data() : nullptr), mesh.start, mesh.count, &min, &max);
+				//(decoding is a per-axis scale and offset, so it maps the corners of the box to corners of the decoded box)
+				glm::vec3 a = mesh.position_offset + mesh.position_scale * min;
+				glm::vec3 b = mesh.position_offset + mesh.position_scale * max;
+				mesh.min = glm::min(a, b);
+				mesh.max = glm::max(a, b);
+			}
+		};
+		//small buffers aren't worth handing to other threads:
+		constexpr uint64_t ParallelVertices = 1 << 18;
+		if (work >= ParallelVertices) {
+			ThreadPool::shared().parallel_for(uint32_t(todo.size()), 4, compute);
+		} else {
+			compute(0, uint32_t(todo.size()));
+		}
+	}
+
+	//store attrib locations:
+	if (format == PNCT) {
+		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(VertexPNCT), offsetof(VertexPNCT, Position));
+		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(VertexPNCT), offsetof(VertexPNCT, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexPNCT), offsetof(VertexPNCT, Color));
+		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(VertexPNCT), offsetof(VertexPNCT, TexCoord));
+	} else if (format == PNC2) {
+		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(VertexPNC2), offsetof(VertexPNC2, Position));
+		Normal = Attrib(4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VertexPNC2), offsetof(VertexPNC2, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexPNC2), offsetof(VertexPNC2, Color));
+		TexCoord = Attrib(2, GL_HALF_FLOAT, GL_FALSE, sizeof(VertexPNC2), offsetof(VertexPNC2, TexCoord));
+	} else {
+		//(w is padding, so only three components are bound; the shader sees w = 1)
+		//(not normalized: GL 3.3 maps normalized shorts c to (2c+1)/65535, which doesn't match the encoding; position_scale includes the 1/32767 instead)
+		Position = Attrib(3, GL_SHORT, GL_FALSE, sizeof(VertexPNQ2), offsetof(VertexPNQ2, Position));
+		Normal = Attrib(4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VertexPNQ2), offsetof(VertexPNQ2, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexPNQ2), offsetof(VertexPNQ2, Color));
+		TexCoord = Attrib(2, GL_HALF_FLOAT, GL_FALSE, sizeof(VertexPNQ2), offsetof(VertexPNQ2, TexCoord));
+	}
+
+	if (!(flags & DeferUpload)) upload();
+
 	/* //DEBUG:
 	std::cout << "File '" << filename << "' contained meshes";
-	for (auto const &m : meshes) {
-		if (&m.second == &meshes.rbegin()->second && meshes.size() > 1) std::cout << " and";
-		std::cout << " '" << m.first << "'";
-		if (&m.second != &meshes.rbegin()->second) std::cout << ",";
+	for (MeshID id = 0; id < mesh_count(); ++id) {
+		if (id + 1 == mesh_count() && mesh_count() > 1) std::cout << " and";
+		std::cout << " '" << name(id) << "'";
+		if (id + 1 != mesh_count()) std::cout << ",";
 	}
 	std::cout << std::endl;
 	*/
 }
 
+MeshBuffer::~MeshBuffer() {
+}
+
+void MeshBuffer::upload() {
+	if (!pending) return;
+
+	//upload data (straight from the mapped file, if nothing during loading rewrote it):
+	// large buffers go through buffer_upload a slice at a time, and file pages are let go as soon as they are copied
+	auto release = [this](uint8_t const *begin, size_t size) {
+		pending->mapped.release(begin, size);
+	};
+	glGenBuffers(1, &buffer);
+	buffer_upload.upload(buffer, pending->vertices.data(), pending->vertices.size(), GL_STATIC_DRAW, release);
+
+	if (pending->indexed) {
+		glGenBuffers(1, &index_buffer);
+		buffer_upload.upload(index_buffer, pending->indices.data(), pending->indices.size() * sizeof(uint32_t), GL_STATIC_DRAW, release);
+	}
+
+	pending.reset(); //(unmaps the file)
+}
+
+void MeshBuffer::write(std::ostream &to) const {
+	if (!pending) {
+		throw std::runtime_error("MeshBuffer data is only kept for write() until upload() (construct with DeferUpload).");
+	}
+	VertexFormat format = pending->format;
+
+	//vertices and (optional) indices, in the format they ended up in:
+	write_chunk(format_magic(format), std::vector< uint8_t >(pending->vertices.begin(), pending->vertices.end()), &to);
+	if (pending->indexed) {
+		write_chunk("ind0", std::vector< uint32_t >(pending->indices.begin(), pending->indices.end()), &to);
+	}
+
+	//names and one index entry per mesh (MeshIDs are file positions, so they survive the trip):
+	write_chunk("str0", std::vector< char >(names.begin(), names.end()), &to);
+	std::vector< IndexEntry > index;
+	index.reserve(meshes.size());
+	for (MeshID id = 0; id < mesh_count(); ++id) {
+		IndexEntry entry;
+		entry.name_begin = name_ranges[id].first;
+		entry.name_end = name_ranges[id].second;
+		entry.vertex_begin = meshes[id].start;
+		entry.vertex_end = meshes[id].start + meshes[id].count;
+		index.emplace_back(entry);
+	}
+	write_chunk("idx0", index, &to);
+
+	if (format == PNQ2) {
+		std::vector< PositionDecode > decode;
+		decode.reserve(meshes.size());
+		for (auto const &mesh : meshes) {
+			decode.emplace_back(PositionDecode{mesh.position_scale, mesh.position_offset});
+		}
+		write_chunk("pqd0", decode, &to);
+	}
+
+	//(so loading doesn't need to compute them)
+	std::vector< MeshBounds > bounds;
+	bounds.reserve(meshes.size());
+	for (auto const &mesh : meshes) {
+		bounds.emplace_back(MeshBounds{mesh.min, mesh.max});
+	}
+	write_chunk("bnd0", bounds, &to);
+
+	//(LOD ranges are in the index chunk, so only indexed buffers have them)
+	bool any_lods = false;
+	for (auto const &mesh : meshes) {
+		if (mesh.lod_count) any_lods = true;
+	}
+	if (any_lods) {
+		assert(pending->indexed);
+		std::vector< MeshLODs > lods;
+		lods.reserve(meshes.size());
+		for (auto const &mesh : meshes) {
+			MeshLODs entry;
+			std::memset(&entry, 0, sizeof(entry));
+			entry.lod_count = mesh.lod_count;
+			for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+				entry.lods[l].begin = mesh.lods[l].start;
+				entry.lods[l].end = mesh.lods[l].start + mesh.lods[l].count;
+			}
+			lods.emplace_back(entry);
+		}
+		write_chunk("lod0", lods, &to);
+	}
+}
+
+void MeshBuffer::replace_with(MeshBuffer &fresh) {
+	assert(!fresh.pending && "MeshBuffers must be uploaded before replacing others");
+
+	//(draws already submitted keep using the old storage; GL frees it once they finish)
+	if (buffer) glDeleteBuffers(1, &buffer);
+	if (index_buffer) glDeleteBuffers(1, &index_buffer);
+	buffer = fresh.buffer;
+	index_buffer = fresh.index_buffer;
+	fresh.buffer = 0;
+	fresh.index_buffer = 0;
+
+	meshes = std::move(fresh.meshes);
+	names = std::move(fresh.names);
+	name_ranges = std::move(fresh.name_ranges);
+	table = std::move(fresh.table);
+	fresh.meshes.clear();
+	fresh.names.clear();
+	fresh.name_ranges.clear();
+	fresh.table.clear();
+
+	Position = fresh.Position;
+	Normal = fresh.Normal;
+	Color = fresh.Color;
+	TexCoord = fresh.TexCoord;
+}
+
 const Mesh &MeshBuffer::lookup(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
+	Mesh const *mesh = try_lookup(name);
+	if (!mesh) {
 		throw std::runtime_error("Looking up mesh '" + name + "' that doesn't exist.");
 	}
-	return f->second;
+	return *mesh;
+}
+
+Mesh const *MeshBuffer::try_lookup(std::string_view name) const {
+	MeshID id = find(name);
+	return (id == InvalidMeshID ? nullptr : &meshes[id]);
+}
+
+MeshID MeshBuffer::find(std::string_view name_) const {
+	if (table.empty()) return InvalidMeshID;
+	uint32_t mask = uint32_t(table.size()) - 1;
+	uint32_t slot = uint32_t(fnv1a64(reinterpret_cast< uint8_t const * >(name_.data()), name_.size())) & mask;
+	//(the table is never more than half full, so this always reaches an empty slot)
+	while (table[slot] != InvalidMeshID) {
+		if (name(table[slot]) == name_) return table[slot];
+		slot = (slot + 1) & mask;
+	}
+	return InvalidMeshID;
+}
+
+void MeshBuffer::add_name(MeshID id, uint64_t hash) {
+	assert(!table.empty() && (table.size() & (table.size() - 1)) == 0);
+	uint32_t mask = uint32_t(table.size()) - 1;
+	uint32_t slot = uint32_t(hash) & mask;
+	while (table[slot] != InvalidMeshID) {
+		slot = (slot + 1) & mask;
+	}
+	table[slot] = id;
 }
 
 GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+	assert(!pending && "DeferUpload buffers must be uploaded before use");
+
 	//create a new vertex array object:
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
@@ -128,6 +800,8 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//indexed meshes take their indices from the element array buffer bound to the vertex array object:
+	if (index_buffer) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
 	glBindVertexArray(0);
 
 	//Check that all active attributes were bound:
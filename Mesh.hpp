@@ -5,38 +5,109 @@
  *  the OpenGL pipeline together.
  * A "MeshBuffer" holds a collection of such meshes (loaded from a file) in
  *  a single OpenGL array buffer. Individual meshes can be looked up by name
- *  using the MeshBuffer::lookup() function.
+ *  using the MeshBuffer::lookup() function (or try_lookup(), which doesn't throw).
+ * Mesh names are interned when the buffer is loaded: each mesh gets a MeshID
+ *  (its position in the file), and find() turns a name into an id with one hash
+ *  table probe sequence. (If a file repeats a name, every mesh still gets its
+ *  id, but find() returns the first.)
  *
  */
 
 #include "GL.hpp"
 #include <glm/glm.hpp>
-#include <map>
+#include <iosfwd>
 #include <limits>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 struct Mesh {
 	//Meshes are vertex ranges (and primitive types) in their MeshBuffer:
 
 	GLenum type = GL_TRIANGLES; //type of primitives in mesh
-	GLuint start = 0; //index of first vertex
-	GLuint count = 0; //count of vertices
+	GLuint start = 0; //index of first vertex (or, for indexed meshes, first index)
+	GLuint count = 0; //count of vertices (or, for indexed meshes, indices)
+	GLenum index_type = 0; //0 => not indexed (draw with glDrawArrays); otherwise the type of indices in the MeshBuffer's index_buffer (draw with glDrawElements)
 
-	//Bounding box.
+	//Position decoding for quantized vertices (object-space position = position_offset + position_scale * attribute):
+	// (identity unless the MeshBuffer stores quantized positions; Scene::Drawable::Pipeline::set_mesh copies these)
+	glm::vec3 position_scale = glm::vec3(1.0f);
+	glm::vec3 position_offset = glm::vec3(0.0f);
+
+	//Coarser versions of an indexed mesh (built by MeshBuffer::GenerateLODs, or read from the file's "lod0" chunk):
+	// lods[i] is a range in the same index buffer with roughly half the triangles of the level before it
+	// (level 0 -- the full mesh -- is start/count above; lods[0] is level 1)
+	enum : uint32_t { MaxLODs = 3 };
+	struct LOD {
+		GLuint start = 0;
+		GLuint count = 0;
+	} lods[MaxLODs];
+	uint32_t lod_count = 0;
+
+	//Bounding box (in decoded object space; read from the file's "bnd0" chunk if it has one, otherwise computed at load).
 	//useful for debug visualization and (perhaps, eventually) collision detection:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
 	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
 };
 
+//Meshes in a MeshBuffer are numbered in file order:
+using MeshID = uint32_t;
+
 struct MeshBuffer {
+	//options for loading:
+	enum Flags : uint32_t {
+		//merge identical vertices and reorder triangles for the post-transform vertex cache:
+		// (turns GL_TRIANGLES meshes into indexed meshes)
+		// note: this is slow for big files -- prefer running scenes/optimize-meshes on them offline
+		OptimizeIndices = (1 << 0),
+		//store full-precision ("pnct") vertices in the compact format -- 2_10_10_10 normals and half-float texcoords:
+		CompactVertices = (1 << 1),
+		//additionally store positions as 16-bit values relative to each mesh's bounding box (implies CompactVertices):
+		// (only possible when meshes don't share vertices -- OptimizeIndices guarantees this)
+		QuantizePositions = (1 << 2),
+		//build up to Mesh::MaxLODs simplified versions of each mesh (turns meshes into indexed meshes):
+		// (does nothing if the file already has LODs)
+		// note: this is slow -- prefer running scenes/optimize-meshes --lods offline
+		GenerateLODs = (1 << 3),
+		//do everything but the OpenGL calls, which wait for upload():
+		// (so the expensive parts of loading can run on a thread without a GL context)
+		DeferUpload = (1 << 4),
+		//print what the steps above did (vertex counts and ACMR before and after, LOD levels made):
+		PrintStats = (1 << 5),
+	};
+
 	//construct from a file:
 	// note: will throw if file fails to read.
-	MeshBuffer(std::string const &filename);
+	MeshBuffer(std::string const &filename, uint32_t flags = 0);
+	~MeshBuffer();
+
+	//create and fill 'buffer' and 'index_buffer' (only needed with DeferUpload; does nothing otherwise):
+	void upload();
+
+	//write the (processed) meshes as a '.pnct' file that loads the same way with no flags:
+	// (used by scenes/optimize-meshes to do the expensive steps of loading offline)
+	// note: only possible before upload(), so construct with DeferUpload; throws otherwise
+	void write(std::ostream &to) const;
+
+	//take over the buffers, meshes, and attribs of an uploaded MeshBuffer, deleting this one's buffers (used for hot reloading):
+	// note: invalidates Mesh references from lookup() and vertex array objects made for this buffer
+	void replace_with(MeshBuffer &fresh);
 
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
 	const Mesh &lookup(std::string const &name) const;
+
+	//...or get nullptr if the mesh isn't found:
+	Mesh const *try_lookup(std::string_view name) const;
+
+	//interned ids (valid until replace_with()):
+	enum : MeshID { InvalidMeshID = -1U };
+	MeshID find(std::string_view name) const; //InvalidMeshID if not found
+	Mesh const &mesh(MeshID id) const { return meshes[id]; }
+	std::string_view name(MeshID id) const { return std::string_view(names.data() + name_ranges[id].first, name_ranges[id].second - name_ranges[id].first); }
+	MeshID mesh_count() const { return MeshID(meshes.size()); }
 	
 	//build a vertex array object that links this vbo to attributes to a program:
 	// note: will throw if program defines attributes not contained in this buffer
@@ -45,10 +116,23 @@ struct MeshBuffer {
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
 
+	//This is the OpenGL element array buffer containing indices for indexed meshes (or 0 if there are none):
+	// (make_vao_for_program binds it to the vertex array object)
+	GLuint index_buffer = 0;
+
 	//-- internals ---
 
-	//used by the lookup() function:
-	std::map< std::string, Mesh > meshes;
+	//meshes, by MeshID:
+	std::vector< Mesh > meshes;
+
+	//names, as ranges in a copy of the file's "str0" chunk (by MeshID):
+	std::string names;
+	std::vector< std::pair< uint32_t, uint32_t > > name_ranges;
+
+	//open-addressing (linear probing) hash table of MeshIDs, keyed by fnv1a64() of the name:
+	// (size is a power of two, at least twice the number of meshes; empty slots hold InvalidMeshID)
+	std::vector< MeshID > table;
+	void add_name(MeshID id, uint64_t hash); //(used while loading)
 
 	//These 'Attrib' structures describe the location of various attributes within the buffer (in exactly format wanted by glVertexAttribPointer). They are set when the file is loaded and are used by the "make_vao_for_program" call:
 	struct Attrib {
@@ -67,4 +151,8 @@ struct MeshBuffer {
 	Attrib Normal;
 	Attrib Color;
 	Attrib TexCoord;
+
+	//file data and processed vertices/indices, kept between construction and upload():
+	struct Pending;
+	std::unique_ptr< Pending > pending;
 };
@@ -0,0 +1,504 @@
+#include "MeshOptimize.hpp"
+
+#include "AssetPack.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+uint32_t dedup_vertices(uint8_t const *vertices, uint32_t stride, uint32_t count, std::vector< uint32_t > *remap_) {
+	assert(remap_);
+	auto &remap = *remap_;
+	remap.assign(count, -1U);
+
+	auto hash_of = [&](uint32_t v) -> size_t {
+		return size_t(fnv1a64(vertices + size_t(v) * stride, stride));
+	};
+	auto equal = [&](uint32_t a, uint32_t b) -> bool {
+		return std::memcmp(vertices + size_t(a) * stride, vertices + size_t(b) * stride, stride) == 0;
+	};
+
+	//maps vertex hash -> first vertex with that hash (collisions are chained by 'next'):
+	std::unordered_map< size_t, uint32_t > first;
+	first.reserve(count);
+	std::vector< uint32_t > next(count, -1U);
+
+	uint32_t unique = 0;
+	for (uint32_t v = 0; v < count; ++v) {
+		size_t h = hash_of(v);
+		auto ret = first.emplace(h, v);
+		if (!ret.second) {
+			uint32_t o = ret.first->second;
+			while (true) {
+				if (equal(o, v)) {
+					remap[v] = remap[o];
+					break;
+				}
+				if (next[o] == -1U) {
+					next[o] = v;
+					break;
+				}
+				o = next[o];
+			}
+		}
+		if (remap[v] == -1U) {
+			remap[v] = unique;
+			unique += 1;
+		}
+	}
+	return unique;
+}
+
+//----------------------------------------------
+//Forsyth vertex cache optimization:
+// see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+
+namespace {
+	constexpr uint32_t CacheSize = 32;
+	constexpr float CacheDecayPower = 1.5f;
+	constexpr float LastTriScore = 0.75f;
+	constexpr float ValenceBoostScale = 2.0f;
+	constexpr float ValenceBoostPower = 0.5f;
+
+	float vertex_score(int32_t cache_position, uint32_t remaining_valence) {
+		if (remaining_valence == 0) return -1.0f; //no triangles need this vertex any more
+
+		float score = 0.0f;
+		if (cache_position < 0) {
+			//not in cache; no score
+		} else if (cache_position < 3) {
+			//used in the last triangle; fixed score (discourages re-using the same edge right away)
+			score = LastTriScore;
+		} else {
+			float scaler = 1.0f / (CacheSize - 3);
+			score = std::pow(1.0f - (cache_position - 3) * scaler, CacheDecayPower);
+		}
+
+		//bonus for vertices with few triangles left, to get rid of lone verts quickly:
+		score += ValenceBoostScale * std::pow(float(remaining_valence), -ValenceBoostPower);
+		return score;
+	}
+}
+
+void optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count) {
+	assert(index_count % 3 == 0);
+	uint32_t tri_count = index_count / 3;
+	if (tri_count == 0) return;
+
+	//vertex -> triangle adjacency (CSR layout):
+	std::vector< uint32_t > adjacency_start(vertex_count + 1, 0);
+	for (uint32_t i = 0; i < index_count; ++i) {
+		assert(indices[i] < vertex_count);
+		adjacency_start[indices[i] + 1] += 1;
+	}
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		adjacency_start[v + 1] += adjacency_start[v];
+	}
+	std::vector< uint32_t > adjacency(index_count);
+	{
+		std::vector< uint32_t > fill(adjacency_start.begin(), adjacency_start.end() - 1);
+		for (uint32_t t = 0; t < tri_count; ++t) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				adjacency[fill[indices[3*t+c]]++] = t;
+			}
+		}
+	}
+
+	std::vector< uint32_t > valence(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		valence[v] = adjacency_start[v + 1] - adjacency_start[v];
+	}
+	std::vector< int32_t > cache_position(vertex_count, -1);
+	std::vector< float > score(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		score[v] = vertex_score(-1, valence[v]);
+	}
+
+	std::vector< bool > emitted(tri_count, false);
+	std::vector< float > tri_score(tri_count);
+	for (uint32_t t = 0; t < tri_count; ++t) {
+		tri_score[t] = score[indices[3*t+0]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+	}
+
+	std::vector< uint32_t > output;
+	output.reserve(index_count);
+
+	//cache contents (most-recently-used first); sized to hold a full cache plus one incoming triangle:
+	uint32_t cache[CacheSize + 3];
+	uint32_t cache_used = 0;
+
+	uint32_t scan = 0; //fallback cursor: everything before it has been emitted
+
+	uint32_t best = 0;
+	{ //start with the best-scoring triangle overall:
+		float best_score = -1.0f;
+		for (uint32_t t = 0; t < tri_count; ++t) {
+			if (tri_score[t] > best_score) {
+				best_score = tri_score[t];
+				best = t;
+			}
+		}
+	}
+
+	for (uint32_t emitted_count = 0; emitted_count < tri_count; ++emitted_count) {
+		assert(!emitted[best]);
+		emitted[best] = true;
+		uint32_t const *tri = indices + 3 * best;
+		output.insert(output.end(), tri, tri + 3);
+
+		//remove the triangle from its vertices' adjacency lists:
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = tri[c];
+			uint32_t *begin = &adjacency[adjacency_start[v]];
+			uint32_t *end = begin + valence[v];
+			uint32_t *f = std::find(begin, end, best);
+			assert(f != end);
+			std::swap(*f, *(end - 1));
+			valence[v] -= 1;
+		}
+
+		//move the triangle's vertices to the front of the cache:
+		uint32_t new_cache[CacheSize + 3];
+		uint32_t new_used = 0;
+		for (uint32_t c = 0; c < 3; ++c) {
+			new_cache[new_used++] = tri[c];
+		}
+		for (uint32_t i = 0; i < cache_used; ++i) {
+			uint32_t v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) new_cache[new_used++] = v;
+		}
+		//vertices pushed out of the cache lose their cache score:
+		for (uint32_t i = CacheSize; i < new_used; ++i) {
+			cache_position[new_cache[i]] = -1;
+			score[new_cache[i]] = vertex_score(-1, valence[new_cache[i]]);
+		}
+		cache_used = std::min(new_used, uint32_t(CacheSize));
+		std::copy(new_cache, new_cache + cache_used, cache);
+
+		//update scores of cached vertices, and the triangles that use them:
+		for (uint32_t i = 0; i < cache_used; ++i) {
+			cache_position[cache[i]] = int32_t(i);
+			score[cache[i]] = vertex_score(int32_t(i), valence[cache[i]]);
+		}
+		float best_score = -1.0f;
+		for (uint32_t i = 0; i < cache_used; ++i) {
+			uint32_t v = cache[i];
+			for (uint32_t a = adjacency_start[v]; a < adjacency_start[v] + valence[v]; ++a) {
+				uint32_t t = adjacency[a];
+				tri_score[t] = score[indices[3*t+0]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+				if (tri_score[t] > best_score) {
+					best_score = tri_score[t];
+					best = t;
+				}
+			}
+		}
+
+		//nothing adjacent to the cache? fall back to the next not-yet-emitted triangle:
+		if (best_score < 0.0f) {
+			while (scan < tri_count && emitted[scan]) ++scan;
+			best = scan;
+		}
+	}
+
+	assert(output.size() == index_count);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+uint32_t optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, std::vector< uint32_t > *new_to_old_) {
+	assert(new_to_old_);
+	auto &new_to_old = *new_to_old_;
+	new_to_old.clear();
+
+	std::vector< uint32_t > old_to_new(vertex_count, -1U);
+	for (uint32_t i = 0; i < index_count; ++i) {
+		uint32_t &o = old_to_new[indices[i]];
+		if (o == -1U) {
+			o = uint32_t(new_to_old.size());
+			new_to_old.emplace_back(indices[i]);
+		}
+		indices[i] = o;
+	}
+	return uint32_t(new_to_old.size());
+}
+
+float compute_acmr(uint32_t const *indices, uint32_t index_count, uint32_t cache_size) {
+	if (index_count < 3) return 0.0f;
+
+	std::vector< uint32_t > fifo(cache_size, -1U);
+	uint32_t head = 0;
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < index_count; ++i) {
+		if (std::find(fifo.begin(), fifo.end(), indices[i]) == fifo.end()) {
+			misses += 1;
+			fifo[head] = indices[i];
+			head = (head + 1) % cache_size;
+		}
+	}
+	return float(misses) / float(index_count / 3);
+}
+
+//----------------------------------------------
+//Quadric error edge-collapse simplification:
+
+namespace {
+	//symmetric 4x4 matrix (upper triangle), representing a sum of squared distances to planes:
+	struct Quadric {
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+		double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+		double a22 = 0.0, a23 = 0.0;
+		double a33 = 0.0;
+
+		//plane n.x*x + n.y*y + n.z*z + d = 0 with weight w:
+		void add_plane(double nx, double ny, double nz, double d, double w) {
+			a00 += w*nx*nx; a01 += w*nx*ny; a02 += w*nx*nz; a03 += w*nx*d;
+			a11 += w*ny*ny; a12 += w*ny*nz; a13 += w*ny*d;
+			a22 += w*nz*nz; a23 += w*nz*d;
+			a33 += w*d*d;
+		}
+		void add(Quadric const &o) {
+			a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+			a11 += o.a11; a12 += o.a12; a13 += o.a13;
+			a22 += o.a22; a23 += o.a23;
+			a33 += o.a33;
+		}
+		double error(float const *p) const {
+			double x = p[0], y = p[1], z = p[2];
+			return a00*x*x + 2.0*a01*x*y + 2.0*a02*x*z + 2.0*a03*x
+			     + a11*y*y + 2.0*a12*y*z + 2.0*a13*y
+			     + a22*z*z + 2.0*a23*z
+			     + a33;
+		}
+	};
+
+	void cross(float const *a, float const *b, float const *c, double *n) {
+		double e1[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+		double e2[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+		n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+		n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+		n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+	}
+}
+
+float simplify_mesh(uint32_t const *indices, uint32_t index_count,
+	float const *positions, float const *normals, uint32_t vertex_count,
+	uint32_t target_index_count, std::vector< uint32_t > *out_) {
+	assert(out_);
+	assert(index_count % 3 == 0);
+	auto &out = *out_;
+	uint32_t tri_count = index_count / 3;
+
+	//weld vertices with identical positions into groups (simplification works on groups):
+	std::vector< uint32_t > group_of;
+	uint32_t group_count = dedup_vertices(reinterpret_cast< uint8_t const * >(positions), 3 * sizeof(float), vertex_count, &group_of);
+	std::vector< uint32_t > group_vertex(group_count); //a representative vertex, for the position
+	std::vector< uint32_t > members_start(group_count + 1, 0); //vertices in each group (CSR layout)
+	std::vector< uint32_t > members(vertex_count);
+	for (uint32_t v = vertex_count; v > 0; --v) {
+		group_vertex[group_of[v-1]] = v-1;
+		members_start[group_of[v-1] + 1] += 1;
+	}
+	for (uint32_t g = 0; g < group_count; ++g) members_start[g + 1] += members_start[g];
+	{
+		std::vector< uint32_t > fill(members_start.begin(), members_start.end() - 1);
+		for (uint32_t v = 0; v < vertex_count; ++v) members[fill[group_of[v]]++] = v;
+	}
+	auto position = [&](uint32_t g) { return positions + 3 * size_t(group_vertex[g]); };
+
+	//triangles as group triples (updated lazily through 'collapsed_to'):
+	std::vector< uint32_t > tris(index_count);
+	for (uint32_t i = 0; i < index_count; ++i) {
+		assert(indices[i] < vertex_count);
+		tris[i] = group_of[indices[i]];
+	}
+	std::vector< uint32_t > collapsed_to(group_count);
+	for (uint32_t g = 0; g < group_count; ++g) collapsed_to[g] = g;
+	auto find = [&](uint32_t g) {
+		while (collapsed_to[g] != g) {
+			collapsed_to[g] = collapsed_to[collapsed_to[g]];
+			g = collapsed_to[g];
+		}
+		return g;
+	};
+
+	//group -> triangles (may contain dead or duplicate entries; filtered on use):
+	std::vector< std::vector< uint32_t > > group_tris(group_count);
+	std::vector< bool > tri_alive(tri_count, true);
+	uint32_t alive = 0;
+	for (uint32_t t = 0; t < tri_count; ++t) {
+		uint32_t *tri = &tris[3*t];
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0]) {
+			tri_alive[t] = false; //(already degenerate)
+			continue;
+		}
+		alive += 1;
+		for (uint32_t c = 0; c < 3; ++c) group_tris[tri[c]].emplace_back(t);
+	}
+
+	//accumulate area-weighted plane quadrics:
+	std::vector< Quadric > quadrics(group_count);
+	std::unordered_map< uint64_t, uint32_t > edge_uses; //directed edge (a,b) -> count
+	edge_uses.reserve(alive * 3);
+	for (uint32_t t = 0; t < tri_count; ++t) {
+		if (!tri_alive[t]) continue;
+		uint32_t const *tri = &tris[3*t];
+		double n[3];
+		cross(position(tri[0]), position(tri[1]), position(tri[2]), n);
+		double len = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+		if (len == 0.0) continue;
+		n[0] /= len; n[1] /= len; n[2] /= len;
+		float const *p = position(tri[0]);
+		double d = -(n[0]*p[0] + n[1]*p[1] + n[2]*p[2]);
+		for (uint32_t c = 0; c < 3; ++c) {
+			quadrics[tri[c]].add_plane(n[0], n[1], n[2], d, 0.5 * len);
+			edge_uses[(uint64_t(tri[c]) << 32) | tri[(c+1)%3]] += 1;
+		}
+	}
+	//open borders get a heavily-weighted plane through the edge, perpendicular to the triangle, so they stay put:
+	constexpr double BorderWeight = 10.0;
+	for (uint32_t t = 0; t < tri_count; ++t) {
+		if (!tri_alive[t]) continue;
+		uint32_t const *tri = &tris[3*t];
+		double n[3];
+		cross(position(tri[0]), position(tri[1]), position(tri[2]), n);
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t a = tri[c], b = tri[(c+1)%3];
+			if (edge_uses.count((uint64_t(b) << 32) | a)) continue; //interior edge
+			float const *pa = position(a);
+			float const *pb = position(b);
+			double e[3] = { double(pb[0]) - pa[0], double(pb[1]) - pa[1], double(pb[2]) - pa[2] };
+			double m[3] = { e[1]*n[2] - e[2]*n[1], e[2]*n[0] - e[0]*n[2], e[0]*n[1] - e[1]*n[0] };
+			double len = std::sqrt(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+			if (len == 0.0) continue;
+			m[0] /= len; m[1] /= len; m[2] /= len;
+			double d = -(m[0]*pa[0] + m[1]*pa[1] + m[2]*pa[2]);
+			double w = BorderWeight * (e[0]*e[0] + e[1]*e[1] + e[2]*e[2]);
+			quadrics[a].add_plane(m[0], m[1], m[2], d, w);
+			quadrics[b].add_plane(m[0], m[1], m[2], d, w);
+		}
+	}
+
+	//candidate collapses, cheapest first; entries go stale when either end changes:
+	struct Collapse {
+		double cost;
+		uint32_t from, to;
+		uint32_t from_version, to_version;
+		bool operator<(Collapse const &o) const { return cost > o.cost; } //(min-heap)
+	};
+	std::vector< uint32_t > version(group_count, 0);
+	std::priority_queue< Collapse > heap;
+	auto push_edge = [&](uint32_t a, uint32_t b) {
+		Quadric q = quadrics[a];
+		q.add(quadrics[b]);
+		double to_b = q.error(position(b));
+		double to_a = q.error(position(a));
+		if (to_b <= to_a) heap.push(Collapse{ to_b, a, b, version[a], version[b] });
+		else heap.push(Collapse{ to_a, b, a, version[b], version[a] });
+	};
+	for (uint32_t t = 0; t < tri_count; ++t) {
+		if (!tri_alive[t]) continue;
+		uint32_t const *tri = &tris[3*t];
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (tri[c] < tri[(c+1)%3]) push_edge(tri[c], tri[(c+1)%3]);
+		}
+	}
+
+	double max_cost = 0.0;
+	uint32_t target_tris = target_index_count / 3;
+	std::vector< uint32_t > neighbors;
+	while (alive > target_tris && !heap.empty()) {
+		Collapse collapse = heap.top();
+		heap.pop();
+		uint32_t a = collapse.from, b = collapse.to;
+		if (collapsed_to[a] != a || collapsed_to[b] != b) continue;
+		if (version[a] != collapse.from_version || version[b] != collapse.to_version) continue;
+
+		//moving 'a' to 'b' must not flip any triangle that survives:
+		bool flips = false;
+		for (uint32_t t : group_tris[a]) {
+			if (!tri_alive[t]) continue;
+			uint32_t g[3] = { find(tris[3*t+0]), find(tris[3*t+1]), find(tris[3*t+2]) };
+			if (g[0] == b || g[1] == b || g[2] == b) continue; //(will be removed by the collapse)
+			float const *p[3] = { position(g[0]), position(g[1]), position(g[2]) };
+			double before[3];
+			cross(p[0], p[1], p[2], before);
+			for (uint32_t c = 0; c < 3; ++c) {
+				if (g[c] == a) p[c] = position(b);
+			}
+			double after[3];
+			cross(p[0], p[1], p[2], after);
+			if (before[0]*after[0] + before[1]*after[1] + before[2]*after[2] <= 0.0) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) continue; //(may become possible later, after its neighborhood changes)
+
+		//collapse:
+		max_cost = std::max(max_cost, collapse.cost);
+		collapsed_to[a] = b;
+		version[a] += 1;
+		version[b] += 1;
+		quadrics[b].add(quadrics[a]);
+		for (uint32_t t : group_tris[a]) {
+			if (!tri_alive[t]) continue;
+			uint32_t g[3] = { find(tris[3*t+0]), find(tris[3*t+1]), find(tris[3*t+2]) };
+			if (g[0] == g[1] || g[1] == g[2] || g[2] == g[0]) {
+				tri_alive[t] = false;
+				alive -= 1;
+			} else {
+				group_tris[b].emplace_back(t);
+			}
+		}
+		group_tris[a].clear();
+		group_tris[a].shrink_to_fit();
+
+		//re-queue edges around 'b' (its quadric changed):
+		auto &bt = group_tris[b];
+		bt.erase(std::remove_if(bt.begin(), bt.end(), [&](uint32_t t){ return !tri_alive[t]; }), bt.end());
+		std::sort(bt.begin(), bt.end());
+		bt.erase(std::unique(bt.begin(), bt.end()), bt.end());
+		neighbors.clear();
+		for (uint32_t t : bt) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t g = find(tris[3*t+c]);
+				if (g != b) neighbors.emplace_back(g);
+			}
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		for (uint32_t n : neighbors) push_edge(b, n);
+	}
+
+	//write out surviving triangles, choosing a vertex for each corner that moved:
+	out.clear();
+	out.reserve(size_t(alive) * 3);
+	for (uint32_t t = 0; t < tri_count; ++t) {
+		if (!tri_alive[t]) continue;
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = indices[3*t+c];
+			uint32_t g = find(group_of[v]);
+			if (g != group_of[v]) {
+				uint32_t best = members[members_start[g]];
+				if (normals) {
+					float const *n = normals + 3 * size_t(v);
+					float best_dot = -2.0f;
+					for (uint32_t m = members_start[g]; m < members_start[g + 1]; ++m) {
+						float const *o = normals + 3 * size_t(members[m]);
+						float dot = n[0]*o[0] + n[1]*o[1] + n[2]*o[2];
+						if (dot > best_dot) {
+							best_dot = dot;
+							best = members[m];
+						}
+					}
+				}
+				v = best;
+			}
+			out.emplace_back(v);
+		}
+	}
+
+	return float(std::sqrt(std::max(0.0, max_cost)));
+}
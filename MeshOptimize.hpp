@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+ * Load-time (or offline) helpers for turning triangle soups into indexed
+ * meshes that make good use of the GPU's post-transform vertex cache.
+ *
+ * Everything here works on raw vertex bytes + a stride, so it doesn't
+ * care about the vertex format; and none of it touches OpenGL.
+ *
+ */
+
+#include <cstdint>
+#include <vector>
+
+//Find bitwise-identical vertices:
+// sets (*remap)[i] to the index of the first vertex identical to vertex i, renumbered densely from zero
+// returns the number of unique vertices
+uint32_t dedup_vertices(uint8_t const *vertices, uint32_t stride, uint32_t count, std::vector< uint32_t > *remap);
+
+//Reorder triangles (in-place) to improve post-transform cache hits, using Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation" scoring:
+// (indices describe a GL_TRIANGLES list; all indices must be < vertex_count)
+void optimize_vertex_cache(uint32_t *indices, uint32_t index_count, uint32_t vertex_count);
+
+//Renumber vertices in order of first use (improves pre-transform fetch locality):
+// rewrites indices in-place; sets (*new_to_old)[n] to the old index of new vertex n
+// returns the number of vertices referenced
+uint32_t optimize_vertex_fetch(uint32_t *indices, uint32_t index_count, uint32_t vertex_count, std::vector< uint32_t > *new_to_old);
+
+//Average cache miss ratio (vertex shader invocations per triangle) of a GL_TRIANGLES index list,
+// as measured by simulating a FIFO cache of the given size:
+// (3.0 is the worst case -- no reuse at all; ~0.5-0.7 is typical for well-ordered meshes)
+float compute_acmr(uint32_t const *indices, uint32_t index_count, uint32_t cache_size = 16);
+
+//Simplify a GL_TRIANGLES index list to (about) target_index_count indices by collapsing edges
+// in order of quadric error (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics"):
+// positions (and, optionally, normals) are packed xyz floats, one per vertex
+// vertices with equal positions are welded while simplifying; open borders are preserved
+// vertices are only ever collapsed onto other existing vertices, so the result indexes the same vertex data:
+//   where a corner moves, it takes the vertex at the new position with the most similar normal
+// stores the new index list in *out; returns the square root of the largest quadric error of any collapse (roughly a distance)
+float simplify_mesh(uint32_t const *indices, uint32_t index_count,
+	float const *positions, float const *normals, uint32_t vertex_count,
+	uint32_t target_index_count, std::vector< uint32_t > *out);
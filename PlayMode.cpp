@@ -7,35 +7,81 @@
 #include "Load.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
+#include "GPUProfiler.hpp"
+#include "DynamicResolution.hpp"
+#include "HotReload.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <random>
 
 
 
 GLuint cyber_meshes_for_lit_color_texture_program = 0;
-Load< MeshBuffer > cyber_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("CyberSauras.pnct"));
-	cyber_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
-	return ret;
+uint32_t cyber_meshes_reloads = 0; //(counts hot reloads, so PlayMode knows when to look up meshes again)
+uint32_t cyber_scene_reloads = 0;
+
+//(CPU parts of loading, shared by the Load<>'s and hot reloading)
+// n.b. vertex merging, cache reordering, position quantization, and LODs are done offline by scenes/optimize-meshes (see scenes/Makefile)
+static MeshBuffer *load_cyber_meshes() {
+	return new MeshBuffer(data_path("CyberSauras.pnct"), MeshBuffer::DeferUpload);
+}
+
+Load< MeshBuffer > cyber_meshes(LoadTagDefault, {}, []() {
+	//parsing happens on a worker thread:
+	MeshBuffer *ret = load_cyber_meshes();
+	return [ret]() -> MeshBuffer const * {
+		ret->upload();
+		cyber_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
+
+		//re-exported meshes replace these buffers in place (PlayMode patches its drawables when cyber_meshes_reloads changes):
+		hot_reload.watch(data_path("CyberSauras.pnct"), [ret]() {
+			std::shared_ptr< MeshBuffer > fresh(load_cyber_meshes());
+			return [ret, fresh]() {
+				fresh->upload();
+				ret->replace_with(*fresh);
+				glDeleteVertexArrays(1, &cyber_meshes_for_lit_color_texture_program);
+				cyber_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
+				cyber_meshes_reloads += 1;
+			};
+		});
+
+		return ret;
+	};
 });
 
-Load< Scene > cyber_scene(LoadTagDefault, []() -> Scene const * {
+static Scene *load_cyber_scene() {
 	return new Scene(data_path("CyberSauras.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
 		Mesh const &mesh = cyber_meshes->lookup(mesh_name);
 
 		scene.drawables.emplace_back(transform);
 		Scene::Drawable &drawable = scene.drawables.back();
+		drawable.mesh = mesh_name;
 
 		drawable.pipeline = lit_color_texture_program_pipeline;
 
 		drawable.pipeline.vao = cyber_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
+		drawable.pipeline.set_mesh(mesh);
 
 	});
+}
+
+Load< Scene > cyber_scene(LoadTagDefault, {&cyber_meshes}, []() {
+	//(no GL calls here, so the whole scene loads on a worker thread)
+	Scene *ret = load_cyber_scene();
+	return [ret]() -> Scene const * {
+		hot_reload.watch(data_path("CyberSauras.scene"), [ret]() {
+			std::shared_ptr< Scene > fresh(load_cyber_scene());
+			//(throws -- so the current scene stays in use -- if the game can't play the new one, e.g. mid-rename in the editor)
+			PlayMode::check_scene(*fresh);
+			return [ret, fresh]() {
+				*ret = *fresh;
+				cyber_scene_reloads += 1;
+			};
+		});
+		return ret;
+	};
 });
 
 float PlayMode::float_abs(float val) {
@@ -46,6 +92,8 @@ float PlayMode::float_abs(float val) {
 
 // Get transforms
 void PlayMode::get_transforms() {
+	check_scene(scene);
+
 	for (auto &transform : scene.transforms) {
 		// Platform
 		if (transform.name == "Platform_Base") platform = &transform;
@@ -75,34 +123,36 @@ void PlayMode::get_transforms() {
 		
 	}
 	
-	if (platform == nullptr) throw std::runtime_error("platform not found.");
-	if (left_bound_obj == nullptr) throw std::runtime_error("left_bound_obj not found.");
-	if (right_bound_obj == nullptr) throw std::runtime_error("right_bound_obj leg not found.");
+	left_leg_rotation = player_left_leg->rotation;
+	right_leg_rotation = player_right_leg->rotation;
 	
-	if (player_left_leg == nullptr) throw std::runtime_error("player_left_leg not found.");
-	if (player_right_leg == nullptr) throw std::runtime_error("player_right_leg not found.");
-	if (player_head == nullptr) throw std::runtime_error("player_head not found.");
-	if (player_torso == nullptr) throw std::runtime_error("player_torso not found.");
+	//get pointer to camera for convenience:
+	camera = &scene.cameras.front();
+}
 
+// Check that a scene has everything get_transforms() looks for
+void PlayMode::check_scene(Scene const &scene) {
+	std::vector< std::string > required = {
+		"Platform_Base", "Left_Bound", "Right_Bound",
+		"Player_Leg_L", "Player_Leg_R", "Player_Head", "Player_Torso",
+	};
 	for(uint32_t i = 0; i < 6; i++) {
-		std::string obstacle_msg = std::string("Obstacle_") + std::to_string(i + 1) + std::string(" not found.");
-		std::string enemye_msg = std::string("EnemyE_Body_") + std::to_string(i + 1) + std::string(" not found.");
-		std::string enemys_msg = std::string("EnemyS_Body_") + std::to_string(i + 1) + std::string(" not found.");
-		if (obstacle[i] == nullptr) throw std::runtime_error(obstacle_msg);
-		if (enemy_eatable[i] == nullptr) throw std::runtime_error(enemye_msg);
-		if (enemy_shooter[i] == nullptr) throw std::runtime_error(enemys_msg);
+		required.emplace_back(std::string("Obstacle_") + std::to_string(i + 1));
+		required.emplace_back(std::string("EnemyE_Body_") + std::to_string(i + 1));
+		required.emplace_back(std::string("EnemyS_Body_") + std::to_string(i + 1));
 	}
 	for(uint32_t i = 0; i < 20; i++) {
-		std::string laser_msg = std::string("Mball_") + std::to_string(i + 1) + std::string(" not found");
-		if (laser[i] == nullptr) throw std::runtime_error(laser_msg);
+		required.emplace_back(std::string("Mball_") + std::to_string(i + 1));
+	}
+
+	for (auto const &name : required) {
+		bool found = std::any_of(scene.transforms.begin(), scene.transforms.end(), [&name](Scene::Transform const &transform) {
+			return transform.name == name;
+		});
+		if (!found) throw std::runtime_error(name + " not found.");
 	}
 
-	left_leg_rotation = player_left_leg->rotation;
-	right_leg_rotation = player_right_leg->rotation;
-	
-	//get pointer to camera for convenience:
 	if (scene.cameras.size() != 1) throw std::runtime_error("Expecting scene to have exactly one camera, but it has " + std::to_string(scene.cameras.size()));
-	camera = &scene.cameras.front();
 }
 
 
@@ -248,9 +298,45 @@ void PlayMode::game_over(){
 
 
 PlayMode::PlayMode() : scene(*cyber_scene) {
+	scene_reloads_seen = cyber_scene_reloads;
+	meshes_reloads_seen = 0; //(so drawables are patched if the meshes have been reloaded since cyber_scene was built)
 	init_state(0);
 }
 
+// Pick up hot-reloaded meshes or scene (see HotReload.hpp)
+void PlayMode::check_reloads() {
+	if (scene_reloads_seen != cyber_scene_reloads) {
+		//a new layout means new transforms, so start over:
+		scene_reloads_seen = cyber_scene_reloads;
+		meshes_reloads_seen = 0;
+		//(the reload already passed check_scene, but don't let a bad scene end the game regardless)
+		Scene previous = scene;
+		try {
+			scene = *cyber_scene;
+			init_state(0);
+		} catch (std::exception &e) {
+			std::cerr << "ERROR using reloaded scene (keeping the previous one): " << e.what() << std::endl;
+			scene = previous;
+			init_state(0);
+		}
+	}
+	if (meshes_reloads_seen != cyber_meshes_reloads && cyber_meshes_reloads != 0) {
+		meshes_reloads_seen = cyber_meshes_reloads;
+		for (auto &drawable : scene.drawables) {
+			if (drawable.mesh.empty()) continue;
+			drawable.pipeline.vao = cyber_meshes_for_lit_color_texture_program;
+			if (Mesh const *mesh = cyber_meshes->try_lookup(drawable.mesh)) {
+				drawable.pipeline.set_mesh(*mesh);
+			} else {
+				//(mesh was removed from the file; hide the drawable rather than drawing stale ranges)
+				std::cerr << "WARNING: reloaded meshes don't include '" << drawable.mesh << "'." << std::endl;
+				drawable.pipeline.count = 0;
+				drawable.pipeline.lod_count = 0;
+			}
+		}
+	}
+}
+
 PlayMode::~PlayMode() {
 }
 
@@ -588,6 +674,8 @@ void PlayMode::update(float elapsed) {
 }
 
 void PlayMode::draw(glm::uvec2 const &drawable_size) {
+	check_reloads();
+
 	//update camera aspect ratio for drawable:
 	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
@@ -599,18 +687,28 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
 	glUseProgram(0);
 
-	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
-	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	//the 3D part of the frame may be drawn at reduced resolution (see DynamicResolution.hpp):
+	dynamic_resolution.begin(drawable_size);
+
+	{ GPUProfiler::Pass pass("clear");
+		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+		glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
 
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
 
 	GL_ERRORS(); //print any errors produced by this setup code
 
-	scene.draw(*camera);
+	{ GPUProfiler::Pass pass("scene");
+		scene.draw(*camera);
+	}
+
+	dynamic_resolution.end(drawable_size);
 
 	{ //use DrawLines to overlay some text:
+		GPUProfiler::Pass pass("hud");
 		glDisable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
 		DrawLines lines(glm::mat4(
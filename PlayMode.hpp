@@ -22,6 +22,9 @@ struct PlayMode : Mode {
 	// Load all transform variables
 	void get_transforms();
 
+	// Throw if a scene is missing objects (or the camera) that get_transforms() needs
+	static void check_scene(Scene const &scene);
+
 	// Hide object
 	void hide_object(Scene::Transform *object);
 
@@ -31,6 +34,11 @@ struct PlayMode : Mode {
 	// Game over logic
 	void game_over();
 
+	// Use hot-reloaded meshes / scene, if they've changed
+	void check_reloads();
+	uint32_t meshes_reloads_seen = 0;
+	uint32_t scene_reloads_seen = 0;
+
 	// Get absolue float value
 	float float_abs(float val);
 
@@ -2,10 +2,14 @@
 
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
+#include "AssetPack.hpp"
+#include "ThreadPool.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 
 //-------------------------
 
@@ -79,6 +83,70 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 //-------------------------
 
+//pipelines are plain data, so scenes can be copied (and commands recorded) without touching the heap:
+static_assert(std::is_trivially_copyable< Scene::Drawable::Pipeline >::value, "Pipeline should be trivially copyable.");
+
+Scene::Drawable::Pipeline::Uniform &Scene::Drawable::Pipeline::uniform_slot(GLint location) {
+	Uniform *empty = nullptr;
+	for (auto &u : uniforms) {
+		if (u.type != Uniform::None && u.location == location) return u;
+		if (u.type == Uniform::None && !empty) empty = &u;
+	}
+	if (!empty) throw std::runtime_error("Pipeline uniform table is full (increase UniformCount).");
+	empty->location = location;
+	return *empty;
+}
+
+void Scene::Drawable::Pipeline::set_uniform(GLint location, GLint value) {
+	if (location == -1) return;
+	Uniform &u = uniform_slot(location);
+	u.type = Uniform::Int;
+	u.value.i = value;
+}
+
+void Scene::Drawable::Pipeline::set_uniform(GLint location, float value) {
+	if (location == -1) return;
+	Uniform &u = uniform_slot(location);
+	u.type = Uniform::Float;
+	u.value.f[0] = value;
+}
+
+void Scene::Drawable::Pipeline::set_uniform(GLint location, glm::vec2 const &value) {
+	if (location == -1) return;
+	Uniform &u = uniform_slot(location);
+	u.type = Uniform::Vec2;
+	std::memcpy(u.value.f, glm::value_ptr(value), sizeof(value));
+}
+
+void Scene::Drawable::Pipeline::set_uniform(GLint location, glm::vec3 const &value) {
+	if (location == -1) return;
+	Uniform &u = uniform_slot(location);
+	u.type = Uniform::Vec3;
+	std::memcpy(u.value.f, glm::value_ptr(value), sizeof(value));
+}
+
+void Scene::Drawable::Pipeline::set_uniform(GLint location, glm::vec4 const &value) {
+	if (location == -1) return;
+	Uniform &u = uniform_slot(location);
+	u.type = Uniform::Vec4;
+	std::memcpy(u.value.f, glm::value_ptr(value), sizeof(value));
+}
+
+void Scene::Drawable::Pipeline::set_mesh(Mesh const &mesh) {
+	type = mesh.type;
+	start = mesh.start;
+	count = mesh.count;
+	index_type = mesh.index_type;
+	position_scale = mesh.position_scale;
+	position_offset = mesh.position_offset;
+	lod_count = mesh.lod_count;
+	std::copy(mesh.lods, mesh.lods + Mesh::MaxLODs, lods);
+	bbox_min = mesh.min;
+	bbox_max = mesh.max;
+}
+
+//-------------------------
+
 
 void Scene::draw(Camera const &camera) const {
 	assert(camera.transform);
@@ -88,76 +156,186 @@ void Scene::draw(Camera const &camera) const {
 }
 
 void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	//scratch space reused between frames (draw is only ever called from the GL thread):
+	static std::vector< DrawCommand > commands;
+	record(world_to_clip, world_to_light, &commands);
+	submit(commands);
+}
 
-	//Iterate through all drawables, sending each one to OpenGL:
-	for (auto const &drawable : drawables) {
-		//Reference to drawable's pipeline for convenience:
-		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+void Scene::record(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light, std::vector< DrawCommand > *commands_) const {
+	assert(commands_);
+	auto &commands = *commands_;
 
+	//Gather drawables that will actually produce output:
+	// (the list walk is serial, but it is the cheap part)
+	static thread_local std::vector< Drawable const * > todo;
+	todo.clear();
+	for (auto const &drawable : drawables) {
 		//skip any drawables without a shader program set:
-		if (pipeline.program == 0) continue;
+		if (drawable.pipeline.program == 0) continue;
 		//skip any drawables that don't reference any vertex array:
-		if (pipeline.vao == 0) continue;
+		if (drawable.pipeline.vao == 0) continue;
 		//skip any drawables that don't contain any vertices:
-		if (pipeline.count == 0) continue;
+		if (drawable.pipeline.count == 0) continue;
 
+		assert(drawable.transform); //drawables *must* have a transform
+		todo.emplace_back(&drawable);
+	}
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
+	commands.resize(todo.size());
+
+	//on-screen size estimates use the projection's vertical scale
+	// (length of the clip-space y row, which rotations in the view transform don't change):
+	float lod_scale = glm::length(glm::vec3(world_to_clip[0][1], world_to_clip[1][1], world_to_clip[2][1]));
+
+	//Compute per-drawable uniforms; chunks of drawables are handled by worker threads:
+	// (small scenes stay on this thread -- waking workers costs more than it saves)
+	constexpr uint32_t Grain = 256;
+	ThreadPool::shared().parallel_for(uint32_t(todo.size()), Grain, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			Drawable const &drawable = *todo[i];
+			Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+			DrawCommand &command = commands[i];
+
+			command.program = pipeline.program;
+			command.vao = pipeline.vao;
+			command.type = pipeline.type;
+			command.start = pipeline.start;
+			command.count = pipeline.count;
+			command.index_type = pipeline.index_type;
+			command.pipeline = &pipeline;
+
+			//the object-to-world matrix is used in all three of these uniforms:
+			glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+
+			//pick a level of detail from the fraction of the viewport height covered by the bounding sphere:
+			if (pipeline.lod_count > 0) {
+				glm::vec3 center = object_to_world * glm::vec4(0.5f * (pipeline.bbox_min + pipeline.bbox_max), 1.0f);
+				float scale = std::max(glm::length(object_to_world[0]), std::max(glm::length(object_to_world[1]), glm::length(object_to_world[2])));
+				float radius = 0.5f * glm::length(pipeline.bbox_max - pipeline.bbox_min) * scale;
+				float w = glm::dot(glm::vec4(world_to_clip[0][3], world_to_clip[1][3], world_to_clip[2][3], world_to_clip[3][3]), glm::vec4(center, 1.0f));
+				if (w > radius) { //(otherwise, the camera is at or inside the bounding sphere)
+					float size = radius * lod_scale / w;
+					uint32_t level = 0;
+					while (level < pipeline.lod_count && size < lod_thresholds[level]) ++level;
+					if (level > 0) {
+						command.start = pipeline.lods[level-1].start;
+						command.count = pipeline.lods[level-1].count;
+					}
+				}
+			}
 
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+			//quantized positions are decoded to object space on the way (normals aren't quantized, so they skip this):
+			glm::mat4 decode = glm::mat4(
+				glm::vec4(pipeline.position_scale.x, 0.0f, 0.0f, 0.0f),
+				glm::vec4(0.0f, pipeline.position_scale.y, 0.0f, 0.0f),
+				glm::vec4(0.0f, 0.0f, pipeline.position_scale.z, 0.0f),
+				glm::vec4(pipeline.position_offset, 1.0f)
+			);
+
+			//OBJECT_TO_CLIP takes vertices from object space to clip space:
+			if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
+				command.OBJECT_TO_CLIP = world_to_clip * glm::mat4(object_to_world) * decode;
+			}
 
-		//Configure program uniforms:
+			//the object-to-light matrix is used in the next two uniforms:
+			glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+			//OBJECT_TO_LIGHT takes vertices from object space to light space:
+			if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+				command.OBJECT_TO_LIGHT = object_to_light * decode;
+			}
 
-		//OBJECT_TO_CLIP takes vertices from object space to clip space:
-		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
-			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+			//NORMAL_TO_LIGHT takes normals from object space to light space:
+			if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
+				command.NORMAL_TO_LIGHT = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
+			}
 		}
+	});
+}
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+void Scene::submit(std::vector< DrawCommand > const &commands) {
+	//state left by the previous command, so that drawables sharing a program, vertex array, or textures
+	// (e.g., sprites packed into one atlas page) don't re-bind them:
+	// (-1U => whatever was bound before submit() was called)
+	GLuint bound_program = -1U;
+	GLuint bound_vao = -1U;
+	Drawable::Pipeline::TextureInfo bound_textures[Drawable::Pipeline::TextureCount];
 
-		//OBJECT_TO_CLIP takes vertices from object space to light space:
-		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
+	//Send each recorded command to OpenGL:
+	for (auto const &command : commands) {
+		//Reference to drawable's pipeline for convenience:
+		Scene::Drawable::Pipeline const &pipeline = *command.pipeline;
+
+		//Set shader program:
+		if (command.program != bound_program) {
+			glUseProgram(command.program);
+			bound_program = command.program;
 		}
 
-		//NORMAL_TO_CLIP takes normals from object space to light space:
+		//Set attribute sources:
+		if (command.vao != bound_vao) {
+			glBindVertexArray(command.vao);
+			bound_vao = command.vao;
+		}
+
+		//Configure program uniforms:
+		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
+			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(command.OBJECT_TO_CLIP));
+		}
+		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(command.OBJECT_TO_LIGHT));
+		}
 		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
-			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(command.NORMAL_TO_LIGHT));
+		}
+		if (pipeline.TEXCOORD_TRANSFORM_vec4 != -1U) {
+			glUniform4fv(pipeline.TEXCOORD_TRANSFORM_vec4, 1, glm::value_ptr(pipeline.texcoord_transform));
 		}
 
 		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+		for (auto const &u : pipeline.uniforms) {
+			if (u.type == Drawable::Pipeline::Uniform::None) continue;
+			else if (u.type == Drawable::Pipeline::Uniform::Int) glUniform1i(u.location, u.value.i);
+			else if (u.type == Drawable::Pipeline::Uniform::Float) glUniform1fv(u.location, 1, u.value.f);
+			else if (u.type == Drawable::Pipeline::Uniform::Vec2) glUniform2fv(u.location, 1, u.value.f);
+			else if (u.type == Drawable::Pipeline::Uniform::Vec3) glUniform3fv(u.location, 1, u.value.f);
+			else if (u.type == Drawable::Pipeline::Uniform::Vec4) glUniform4fv(u.location, 1, u.value.f);
+		}
 
 		//set up textures:
+		// (units the pipeline doesn't use are left unbound, as if textures were un-bound after every draw)
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+			auto const &want = pipeline.textures[i];
+			auto &bound = bound_textures[i];
+			if (want.texture == bound.texture && (want.texture == 0 || want.target == bound.target)) continue;
+			glActiveTexture(GL_TEXTURE0 + i);
+			if (bound.texture != 0 && (want.texture == 0 || want.target != bound.target)) {
+				glBindTexture(bound.target, 0);
+			}
+			if (want.texture != 0) {
+				glBindTexture(want.target, want.texture);
 			}
+			bound = want;
 		}
 
 		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
-
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
+		if (command.index_type == 0) {
+			glDrawArrays(command.type, command.start, command.count);
+		} else {
+			GLsizei index_size = (command.index_type == GL_UNSIGNED_INT ? 4 : (command.index_type == GL_UNSIGNED_SHORT ? 2 : 1));
+			glDrawElements(command.type, command.count, command.index_type, (GLbyte *)0 + size_t(command.start) * index_size);
 		}
-		glActiveTexture(GL_TEXTURE0);
+	}
 
+	//un-bind textures:
+	for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+		if (bound_textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(bound_textures[i].target, 0);
+		}
 	}
+	glActiveTexture(GL_TEXTURE0);
 
 	glUseProgram(0);
 	glBindVertexArray(0);
@@ -169,10 +347,11 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 void Scene::load(std::string const &filename,
 	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
 
-	std::ifstream file(filename, std::ios::binary);
+	//chunks are read in place from the mapped file (or pack):
+	AssetFile mapped(filename);
+	ChunkReader file(mapped.data(), mapped.size(), filename);
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	ChunkSpan< char > names = file.read< char >("str0");
 
 	struct HierarchyEntry {
 		uint32_t parent;
@@ -183,8 +362,7 @@ void Scene::load(std::string const &filename,
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
+	ChunkSpan< HierarchyEntry > hierarchy = file.read< HierarchyEntry >("xfh0");
 
 	struct MeshEntry {
 		uint32_t transform;
@@ -192,8 +370,7 @@ void Scene::load(std::string const &filename,
 		uint32_t name_end;
 	};
 	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
+	ChunkSpan< MeshEntry > meshes = file.read< MeshEntry >("msh0");
 
 	struct CameraEntry {
 		uint32_t transform;
@@ -202,8 +379,7 @@ void Scene::load(std::string const &filename,
 		float clip_near, clip_far;
 	};
 	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > cameras;
-	read_chunk(file, "cam0", &cameras);
+	ChunkSpan< CameraEntry > cameras = file.read< CameraEntry >("cam0");
 
 	struct LightEntry {
 		uint32_t transform;
@@ -214,8 +390,7 @@ void Scene::load(std::string const &filename,
 		float fov;
 	};
 	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > lights;
-	read_chunk(file, "lmp0", &lights);
+	ChunkSpan< LightEntry > lights = file.read< LightEntry >("lmp0");
 
 
 	//--------------------------------
@@ -304,7 +479,7 @@ void Scene::load(std::string const &filename,
 	//load any extra that a subclass wants:
 	load_extra(file, names, hierarchy_transforms);
 
-	if (file.peek() != EOF) {
+	if (!file.at_end()) {
 		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
 	}
 
@@ -357,6 +532,8 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		t.parent = transform_to_transform.at(t.parent);
 	}
 
+	std::copy(other.lod_thresholds, other.lod_thresholds + Mesh::MaxLODs, lod_thresholds);
+
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
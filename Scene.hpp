@@ -11,6 +11,7 @@
  */
 
 #include "GL.hpp"
+#include "Mesh.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -22,6 +23,9 @@
 #include <vector>
 #include <unordered_map>
 
+struct ChunkReader;
+template< typename T > struct ChunkSpan;
+
 struct Scene {
 	struct Transform {
 		//Transform names are useful for debugging and looking up locations in a loaded scene:
@@ -54,6 +58,9 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//name of the mesh drawn, if set by the code that made this drawable (lets meshes be found again after hot reloading):
+		std::string mesh;
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -64,13 +71,50 @@ struct Scene {
 			GLenum type = GL_TRIANGLES; //what sort of primitive to draw; passed to glDrawArrays
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
+			GLenum index_type = 0; //if nonzero, draw with glDrawElements instead: start/count are in indices of this type (from the vao's element array buffer)
+
+			//decoding for quantized vertex positions (applied to OBJECT_TO_CLIP and OBJECT_TO_LIGHT, but not NORMAL_TO_LIGHT):
+			glm::vec3 position_scale = glm::vec3(1.0f);
+			glm::vec3 position_offset = glm::vec3(0.0f);
+
+			//level-of-detail (record() picks one of these instead of start/count when the drawable is small on screen):
+			uint32_t lod_count = 0;
+			Mesh::LOD lods[Mesh::MaxLODs];
+			glm::vec3 bbox_min = glm::vec3(0.0f); //object-space bounds, used to estimate on-screen size
+			glm::vec3 bbox_max = glm::vec3(0.0f);
+
+			//copy type, start, count, index_type, position decoding, and LODs from a mesh:
+			void set_mesh(Mesh const &mesh);
 
 			//uniforms:
 			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
 			GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
-
-			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
+			GLuint TEXCOORD_TRANSFORM_vec4 = -1U; //uniform location for texcoord scale (xy) and offset (zw); set from texcoord_transform
+
+			//maps texture coordinates into this drawable's part of a shared texture (e.g., an atlas page; see Texture.hpp):
+			glm::vec4 texcoord_transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+			//any other useful uniforms (e.g., material parameters), stored as plain values
+			// so that pipelines stay trivially copyable; set in order before drawing:
+			enum : uint32_t { UniformCount = 4 };
+			struct Uniform {
+				enum Type : uint32_t { None = 0, Int, Float, Vec2, Vec3, Vec4 } type = None;
+				GLint location = -1;
+				union {
+					GLint i;
+					float f[4];
+				} value = { 0 };
+			} uniforms[UniformCount];
+
+			//add (or replace) an entry in uniforms[] for the given location:
+			// note: will throw if the table is full; locations of -1 (uniform not in program) are ignored
+			void set_uniform(GLint location, GLint value);
+			void set_uniform(GLint location, float value);
+			void set_uniform(GLint location, glm::vec2 const &value);
+			void set_uniform(GLint location, glm::vec3 const &value);
+			void set_uniform(GLint location, glm::vec4 const &value);
+			Uniform &uniform_slot(GLint location); //(used by the above)
 
 			//texture objects to bind for the first TextureCount textures:
 			enum : uint32_t { TextureCount = 4 };
@@ -122,12 +166,42 @@ struct Scene {
 	std::list< Camera > cameras;
 	std::list< Light > lights;
 
+	//Level-of-detail selection: a drawable whose bounding sphere spans less than lod_thresholds[i]
+	// of the viewport height is drawn with LOD level i+1 (if its mesh has one):
+	// (thresholds should be decreasing; set them all to 0.0f to always draw full detail)
+	float lod_thresholds[Mesh::MaxLODs] = { 0.25f, 0.1f, 0.04f };
+
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
 	void draw(Camera const &camera) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//"draw" is built from two phases, which can also be called separately:
+	// record() does the per-drawable CPU work (matrices, skipping empty drawables) into a flat list of commands;
+	//   it makes no OpenGL calls and spreads large scenes over worker threads.
+	// submit() replays a list of commands through OpenGL; call it on the thread that owns the GL context.
+	//   (it only changes program, vertex array, and texture bindings when they differ from the previous command's)
+	struct DrawCommand {
+		//copied from the drawable's pipeline (start/count from the chosen level of detail):
+		GLuint program = 0;
+		GLuint vao = 0;
+		GLenum type = GL_TRIANGLES;
+		GLuint start = 0;
+		GLuint count = 0;
+		GLenum index_type = 0;
+
+		//uniform values computed during recording:
+		glm::mat4 OBJECT_TO_CLIP;
+		glm::mat4x3 OBJECT_TO_LIGHT;
+		glm::mat3 NORMAL_TO_LIGHT;
+
+		//the rest (uniform locations, uniform values, textures) is read from the pipeline at submit time:
+		Drawable::Pipeline const *pipeline = nullptr;
+	};
+	void record(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light, std::vector< DrawCommand > *commands) const;
+	static void submit(std::vector< DrawCommand > const &commands);
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
@@ -137,7 +211,8 @@ struct Scene {
 
 	//this function is called to read extra chunks from the scene file after the main chunks are read:
 	// this is useful if you, e.g., subclassing scene to represent a game level/area
-	virtual void load_extra(std::istream &from, std::vector< char > const &str0, std::vector< Transform * > const &xfh0) { }
+	// (read chunks with from.read< T >(magic); see read_write_chunk.hpp)
+	virtual void load_extra(ChunkReader &from, ChunkSpan< char > const &str0, std::vector< Transform * > const &xfh0) { }
 
 	//empty scene:
 	Scene() = default;
@@ -0,0 +1,341 @@
+#include "ScreenCapture.hpp"
+
+#include "ThreadPool.hpp"
+#include "load_save_png.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+ScreenCapture screen_capture;
+
+ScreenCapture::ScreenCapture() {
+}
+
+ScreenCapture::~ScreenCapture() {
+	//n.b. GL objects must be released by finish() while the context still exists; this just waits on the workers:
+	workers.reset();
+}
+
+void ScreenCapture::screenshot(std::string const &filename) {
+	requested.emplace_back(filename);
+}
+
+void ScreenCapture::start_recording(std::string const &prefix, uint32_t every, Format format) {
+	if (record.active) stop_recording();
+	record.active = true;
+	record.prefix = prefix;
+	record.every = std::max(1u, every);
+	record.format = format;
+	record.frame = 0;
+	{
+		std::unique_lock< std::mutex > lock(log_mutex);
+		log.clear();
+	}
+	std::cout << "Recording one of every " << record.every << " frames to '" << prefix << "*" << (format == Raw ? ".rgba" : ".png") << "'." << std::endl;
+}
+
+void ScreenCapture::stop_recording() {
+	if (!record.active) return;
+	record.active = false;
+
+	//write out everything already captured:
+	collect(true);
+	wait_for_workers();
+
+	std::vector< LogEntry > entries;
+	{
+		std::unique_lock< std::mutex > lock(log_mutex);
+		entries.swap(log);
+	}
+	std::sort(entries.begin(), entries.end(), [](LogEntry const &a, LogEntry const &b) {
+		return a.frame < b.frame;
+	});
+
+	std::string log_file = record.prefix + "log.csv";
+	std::ofstream csv(log_file);
+	csv << "frame,width,height,status,readback_ms,total_ms\n";
+	uint32_t saved = 0, dropped = 0;
+	std::vector< float > latencies;
+	for (auto const &e : entries) {
+		csv << e.frame << ',' << e.size.x << ',' << e.size.y << ',' << e.status << ',' << e.readback_ms << ',' << e.total_ms << '\n';
+		if (std::strcmp(e.status, "saved") == 0) {
+			saved += 1;
+			latencies.emplace_back(e.total_ms);
+		} else if (std::strncmp(e.status, "dropped", 7) == 0) {
+			dropped += 1;
+		}
+	}
+	if (!csv) {
+		std::cerr << "WARNING: failed to write capture log '" << log_file << "'." << std::endl;
+	}
+
+	std::cout << "Recording stopped after " << record.frame << " frames: " << saved << " saved, " << dropped << " dropped";
+	if (!latencies.empty()) {
+		std::sort(latencies.begin(), latencies.end());
+		std::cout << "; latency median " << latencies[latencies.size() / 2] << "ms, max " << latencies.back() << "ms";
+	}
+	std::cout << " (details in '" << log_file << "')." << std::endl;
+}
+
+void ScreenCapture::add_log(LogEntry const &entry) {
+	std::unique_lock< std::mutex > lock(log_mutex);
+	log.emplace_back(entry);
+}
+
+void ScreenCapture::end_frame(glm::uvec2 const &drawable_size) {
+	//hand off anything the GPU has finished copying:
+	collect(false);
+
+	//nothing to read back (e.g., minimized window); screenshots wait for the next real frame, and
+	// recording frame numbers aren't used up, so the log and filenames stay contiguous:
+	if (drawable_size.x == 0 || drawable_size.y == 0) return;
+
+	//does this frame belong to the recording?
+	bool record_this = false;
+	uint32_t frame = 0;
+	if (record.active) {
+		frame = record.frame++;
+		if (frame % record.every == 0) {
+			if (record.in_flight < RecordReadbacks) {
+				record_this = true;
+			} else {
+				//GPU is behind; skip the frame rather than stall on it:
+				LogEntry entry;
+				entry.frame = frame;
+				entry.size = drawable_size;
+				entry.status = "dropped-readback";
+				add_log(entry);
+			}
+		}
+	}
+
+	if (requested.empty() && !record_this) return;
+
+	Readback readback;
+	readback.size = drawable_size;
+	readback.issued = Clock::now();
+	GLsizeiptr bytes = GLsizeiptr(drawable_size.x) * drawable_size.y * 4;
+
+	if (drawable_size != pbo_size) {
+		//(buffers still in flight are deleted as they come back; see release_pbo)
+		if (!free_pbos.empty()) {
+			glDeleteBuffers(GLsizei(free_pbos.size()), free_pbos.data());
+			free_pbos.clear();
+		}
+		pbo_size = drawable_size;
+	}
+	if (!free_pbos.empty()) {
+		readback.pbo = free_pbos.back();
+		free_pbos.pop_back();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+	} else {
+		glGenBuffers(1, &readback.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+	}
+
+	//copy from the back buffer into the PBO (returns immediately -- the copy happens on the GPU):
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glReadPixels(0, 0, drawable_size.x, drawable_size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	//one entry per output; entries after the first share its pixels:
+	std::vector< Readback > entries;
+	for (auto const &filename : requested) {
+		entries.emplace_back(readback);
+		entries.back().filename = filename;
+	}
+	requested.clear();
+	if (record_this) {
+		std::string number = std::to_string(frame);
+		if (number.size() < 6) number = std::string(6 - number.size(), '0') + number;
+		entries.emplace_back(readback);
+		entries.back().filename = record.prefix + number + (record.format == Raw ? ".rgba" : ".png");
+		entries.back().recorded = true;
+		entries.back().raw = (record.format == Raw);
+		entries.back().frame = frame;
+		record.in_flight += 1;
+	}
+	for (uint32_t i = 1; i < entries.size(); ++i) {
+		entries[i].pbo = 0;
+		entries[i].fence = 0;
+	}
+	pending.insert(pending.end(), entries.begin(), entries.end());
+
+	GL_ERRORS();
+}
+
+void ScreenCapture::collect(bool wait) {
+	while (!pending.empty()) {
+		Readback &readback = pending.front();
+		if (readback.fence) {
+			GLenum result = glClientWaitSync(readback.fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED && wait) {
+				do {
+					result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break; //(not done yet; try next frame)
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+		}
+
+		//gather this read-back and any entries that share its pixels:
+		uint32_t shared = 1;
+		while (shared < pending.size() && pending[shared].pbo == 0) {
+			++shared;
+		}
+		std::vector< Readback > outputs(pending.begin(), pending.begin() + shared);
+
+		glm::uvec2 size = readback.size;
+		void const *data = nullptr;
+		std::shared_ptr< std::atomic< bool > > copied;
+
+		//recorded frames are dropped (rather than queued) if the encoders are backed up:
+		bool busy = (in_progress.load() >= RecordQueue);
+		Clock::time_point mapped_at = Clock::now();
+		for (auto &out : outputs) {
+			if (!out.recorded) continue;
+			assert(record.in_flight > 0);
+			record.in_flight -= 1;
+			if (busy) {
+				LogEntry entry;
+				entry.frame = out.frame;
+				entry.size = size;
+				entry.status = "dropped-queue";
+				entry.readback_ms = std::chrono::duration< float, std::milli >(mapped_at - out.issued).count();
+				entry.total_ms = entry.readback_ms;
+				add_log(entry);
+				out.filename.clear();
+			}
+		}
+		outputs.erase(std::remove_if(outputs.begin(), outputs.end(), [](Readback const &out) {
+			return out.filename.empty();
+		}), outputs.end());
+
+		if (!outputs.empty()) {
+			//(the worker copies out of the mapping; the buffer is unmapped by a later unmap_copied)
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+			data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(size.x) * size.y * 4, GL_MAP_READ_BIT);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			if (!data) {
+				std::cerr << "WARNING: failed to map screen capture buffer; skipping '" << readback.filename << "'." << std::endl;
+			}
+		}
+		if (data) {
+			copied = std::make_shared< std::atomic< bool > >(false);
+			mapped.emplace_back(Mapped{readback.pbo, size, copied});
+		} else {
+			release_pbo(readback.pbo, size);
+		}
+		pending.erase(pending.begin(), pending.begin() + shared);
+
+		if (!data) continue;
+
+		//copying, alpha fix-up, and encoding happen on background threads:
+		if (!workers) workers.reset(new ThreadPool(std::max(1u, std::thread::hardware_concurrency() / 2)));
+		in_progress += 1;
+		workers->run([this,data,copied,size,outputs,mapped_at](){
+			//copy the pixels out of the mapped buffer, making the image opaque on the way
+			// (the default framebuffer's alpha isn't meaningful; done a word at a time, so the compiler can vectorize it):
+			std::vector< glm::u8vec4 > pixels;
+			try {
+				pixels.resize(size_t(size.x) * size.y);
+				uint32_t const *from = reinterpret_cast< uint32_t const * >(data);
+				uint32_t *words = reinterpret_cast< uint32_t * >(pixels.data());
+				uint32_t opaque;
+				glm::u8vec4 const alpha = glm::u8vec4(0x00, 0x00, 0x00, 0xff);
+				std::memcpy(&opaque, &alpha, 4);
+				for (size_t i = 0; i < pixels.size(); ++i) {
+					words[i] = from[i] | opaque;
+				}
+			} catch (std::exception &e) {
+				std::cerr << "ERROR copying screen capture: " << e.what() << std::endl;
+				pixels.clear();
+			}
+			copied->store(true); //(the main thread may unmap the buffer from here on)
+
+			for (auto const &out : outputs) {
+				bool ok = true;
+				try {
+					if (pixels.empty()) throw std::runtime_error("pixels weren't copied");
+					if (out.raw) {
+						std::ofstream raw(out.filename, std::ios::binary);
+						raw.write(reinterpret_cast< char const * >(pixels.data()), pixels.size() * 4);
+						if (!raw) throw std::runtime_error("failed to write raw frame");
+					} else {
+						save_png(out.filename, size, pixels.data(), LowerLeftOrigin);
+					}
+					if (!out.recorded) std::cout << "Saved screenshot to '" << out.filename << "'." << std::endl;
+				} catch (std::exception &e) {
+					std::cerr << "ERROR saving capture '" << out.filename << "': " << e.what() << std::endl;
+					ok = false;
+				}
+				if (out.recorded) {
+					LogEntry entry;
+					entry.frame = out.frame;
+					entry.size = size;
+					entry.status = (ok ? "saved" : "failed");
+					entry.readback_ms = std::chrono::duration< float, std::milli >(mapped_at - out.issued).count();
+					entry.total_ms = std::chrono::duration< float, std::milli >(Clock::now() - out.issued).count();
+					add_log(entry);
+				}
+			}
+			in_progress -= 1;
+		});
+	}
+
+	unmap_copied(wait);
+}
+
+void ScreenCapture::unmap_copied(bool wait) {
+	for (auto m = mapped.begin(); m != mapped.end(); ) {
+		if (!m->copied->load()) {
+			if (!wait) {
+				++m;
+				continue;
+			}
+			while (!m->copied->load()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m->pbo);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		release_pbo(m->pbo, m->size);
+		m = mapped.erase(m);
+	}
+}
+
+void ScreenCapture::release_pbo(GLuint pbo, glm::uvec2 size) {
+	if (size == pbo_size) {
+		free_pbos.emplace_back(pbo);
+	} else {
+		glDeleteBuffers(1, &pbo);
+	}
+}
+
+void ScreenCapture::wait_for_workers() {
+	while (in_progress.load() != 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void ScreenCapture::finish() {
+	stop_recording();
+	collect(true);
+	wait_for_workers();
+	if (!free_pbos.empty()) {
+		glDeleteBuffers(GLsizei(free_pbos.size()), free_pbos.data());
+		free_pbos.clear();
+	}
+}
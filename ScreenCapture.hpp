@@ -0,0 +1,143 @@
+#pragma once
+
+/*
+ * ScreenCapture saves the contents of the default framebuffer without stalling
+ * the render loop.
+ *
+ * Frames are read into pixel buffer objects (an asynchronous copy on the GPU),
+ * mapped a frame or two later once a fence says the copy is done, and then
+ * handed -- still mapped -- to a background thread, which copies the pixels out
+ * (with alpha fix-up) and encodes them. The buffer is unmapped on a later
+ * frame, once the copy is done, so the render loop never touches the pixels.
+ *
+ * It can also record every frame (or every Nth frame) as an image sequence.
+ * Recording never waits on the GPU or the encoders. A frame is dropped when
+ * all of the read-back buffers set aside for recording are still in flight,
+ * or when too many frames are already waiting to be written. Each frame's
+ * latency is logged so dropped or slow frames are easy to spot.
+ *
+ * Usage:
+ *  //e.g., in a key handler:
+ *  screen_capture.screenshot("screenshot.png");
+ *
+ *  //in the main loop, after drawing and before swapping:
+ *  screen_capture.end_frame(drawable_size);
+ *
+ *  //record frames 0, 2, 4, ... to capture-000000.png, capture-000002.png, ...:
+ *  screen_capture.start_recording("capture-", 2);
+ *  //...later (writes capture-log.csv):
+ *  screen_capture.stop_recording();
+ *
+ *  //before destroying the GL context:
+ *  screen_capture.finish();
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ThreadPool;
+
+struct ScreenCapture {
+	ScreenCapture();
+	~ScreenCapture();
+
+	//save the next frame drawn to 'filename' (as a PNG):
+	void screenshot(std::string const &filename);
+
+	//start reading back this frame (if requested) and pass finished read-backs to the background thread:
+	// (call after drawing, while the frame is still in the back buffer)
+	void end_frame(glm::uvec2 const &drawable_size);
+
+	//wait for all outstanding captures to be written and release GL objects:
+	// (also stops recording)
+	void finish();
+
+	//--- continuous capture ---
+	enum Format : uint8_t {
+		PNG, //<prefix>NNNNNN.png
+		Raw, //<prefix>NNNNNN.rgba -- width x height RGBA8, bottom row first (size is in the log)
+	};
+
+	//capture every 'every'th frame from the next end_frame() on (frame numbers count from zero at the start):
+	void start_recording(std::string const &prefix, uint32_t every = 1, Format format = PNG);
+
+	//stop capturing, wait for captured frames to be written, and save <prefix>log.csv:
+	void stop_recording();
+
+	bool recording() const { return record.active; }
+
+	//--- internals ---
+	using Clock = std::chrono::high_resolution_clock;
+
+	std::vector< std::string > requested; //filenames for the next frame
+
+	struct Readback {
+		GLuint pbo = 0;
+		GLsync fence = 0;
+		glm::uvec2 size = glm::uvec2(0);
+		std::string filename;
+		bool recorded = false; //part of a recording (rather than a screenshot)
+		bool raw = false; //write as Raw rather than PNG
+		uint32_t frame = 0; //(recording frame number)
+		Clock::time_point issued;
+	};
+	std::vector< Readback > pending; //oldest first
+
+	//pixel buffers are allocated once for the current drawable size and reused (reallocated only when the size changes):
+	glm::uvec2 pbo_size = glm::uvec2(0);
+	std::vector< GLuint > free_pbos; //(all of size pbo_size)
+	void release_pbo(GLuint pbo, glm::uvec2 size); //back to free_pbos, or deleted if the size is out of date
+
+	//buffers mapped for a worker to copy pixels out of:
+	struct Mapped {
+		GLuint pbo = 0;
+		glm::uvec2 size = glm::uvec2(0);
+		std::shared_ptr< std::atomic< bool > > copied; //set by the worker once it is done with the mapping
+	};
+	std::vector< Mapped > mapped;
+	void unmap_copied(bool wait); //unmap and release buffers workers are done with (or, if wait is set, all of them)
+
+	enum : uint32_t {
+		RecordReadbacks = 3, //at most this many recorded frames may be waiting on the GPU
+		RecordQueue = 6, //at most this many mapped frames may be waiting on the encoders
+	};
+
+	struct {
+		bool active = false;
+		std::string prefix;
+		uint32_t every = 1;
+		Format format = PNG;
+		uint32_t frame = 0; //(non-empty) frames seen since start_recording
+		uint32_t in_flight = 0; //recorded read-backs in 'pending'
+	} record;
+
+	//per-frame latencies, for the recording log:
+	struct LogEntry {
+		uint32_t frame = 0;
+		glm::uvec2 size = glm::uvec2(0);
+		char const *status = ""; //"saved", "dropped-readback", "dropped-queue", "failed"
+		float readback_ms = 0.0f; //end_frame() to mapped
+		float total_ms = 0.0f; //end_frame() to written
+	};
+	std::mutex log_mutex; //guards 'log' (written by workers)
+	std::vector< LogEntry > log;
+	void add_log(LogEntry const &entry);
+
+	std::unique_ptr< ThreadPool > workers; //started on first capture
+	std::atomic< uint32_t > in_progress{0}; //captures handed to workers but not yet written
+
+	void collect(bool wait); //map finished read-backs (or all of them, if wait is set) and queue them for saving; unmap copied ones
+	void wait_for_workers(); //block until in_progress is zero
+};
+
+extern ScreenCapture screen_capture;
@@ -2,10 +2,11 @@
 
 #include "ShowMeshesProgram.hpp"
 #include "DrawLines.hpp"
+#include "GPUProfiler.hpp"
 
 #include <iostream>
 
-ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
+ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_, TextureSet const *textures_) : buffer(buffer_), textures(textures_) {
 	vao = buffer.make_vao_for_program(show_meshes_program->program);
 
 	//Set up scene:
@@ -32,6 +33,9 @@ ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
 
 	//select first mesh in buffer:
 	select_prev_mesh();
+
+	//start textured, if there are textures to show:
+	select_texture(0);
 }
 
 ShowMeshesMode::~ShowMeshesMode() {
@@ -47,6 +51,11 @@ bool ShowMeshesMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window
 			select_prev_mesh();
 			return true;
 		}
+		if (evt.key.keysym.sym == SDLK_t) {
+			//cycle through textures, then none:
+			select_texture(current_texture + 1);
+			return true;
+		}
 	}
 
 	//----- trackball-style camera controls -----
@@ -114,15 +123,20 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 
 
 	//--- actual drawing ---
-	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	{ GPUProfiler::Pass pass("clear");
+		glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
 	glDisable(GL_BLEND);
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
-	scene.draw(*scene_camera);
+	{ GPUProfiler::Pass pass("scene");
+		scene.draw(*scene_camera);
+	}
 
 	{ //decorate with some lines:
+		GPUProfiler::Pass pass("lines");
 		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->make_world_to_local()));
 
 		//axis (unit-length):
@@ -142,7 +156,9 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 		draw_lines.draw_box(mat, glm::u8vec4(0xdd, 0xdd, 0xdd, 0xff));
 
 		//mesh name:
-		draw_lines.draw_text("'" + current_mesh_name + "'",
+		std::string label = "'" + current_mesh_name + "'";
+		if (textures && current_texture < textures->names.size()) label += " [" + textures->names[current_texture] + "]";
+		draw_lines.draw_text(label,
 			current_mesh_min + glm::vec3(0.0f, -0.20f, 0.0f),
 			0.15f * glm::vec3(1.0f, 0.0f, 0.0f),
 			0.15f * glm::vec3(0.0f, 1.0f, 0.0f),
@@ -152,52 +168,46 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 }
 
 void ShowMeshesMode::select_prev_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) --f;
-	if (f == buffer.meshes.end()) f = buffer.meshes.begin();
-
-	if (f != buffer.meshes.end()) {
-		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
-		current_mesh_min = f->second.min;
-		current_mesh_max = f->second.max;
-	} else {
-		current_mesh_name = "";
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
-		current_mesh_min = glm::vec3(0.0f);
-		current_mesh_max = glm::vec3(0.0f);
-	}
+	//(meshes are in file order; stops at the first one)
+	MeshID id = current_mesh_id;
+	if (id == MeshBuffer::InvalidMeshID || id == 0) id = 0;
+	else id -= 1;
+	select_mesh(id);
 }
 
 void ShowMeshesMode::select_next_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) ++f;
-	if (f == buffer.meshes.end()) {
-		auto temp = buffer.meshes.rbegin();
-		if (temp != buffer.meshes.rend()) {
-			++temp;
-			f = temp.base();
-			assert(f != buffer.meshes.end());
-		}
-	}
+	//(stops at the last one)
+	MeshID id = current_mesh_id;
+	if (id == MeshBuffer::InvalidMeshID || id + 1 >= buffer.mesh_count()) id = buffer.mesh_count() - 1;
+	else id += 1;
+	select_mesh(id);
+}
 
-	if (f != buffer.meshes.end()) {
-		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
-		current_mesh_min = f->second.min;
-		current_mesh_max = f->second.max;
+void ShowMeshesMode::select_mesh(MeshID id) {
+	if (id < buffer.mesh_count()) {
+		Mesh const &mesh = buffer.mesh(id);
+		current_mesh_id = id;
+		current_mesh_name = std::string(buffer.name(id));
+		scene_drawable->pipeline.set_mesh(mesh);
+		current_mesh_min = mesh.min;
+		current_mesh_max = mesh.max;
 	} else {
+		current_mesh_id = MeshBuffer::InvalidMeshID;
 		current_mesh_name = "";
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.set_mesh(Mesh());
 		current_mesh_min = glm::vec3(0.0f);
 		current_mesh_max = glm::vec3(0.0f);
 	}
 }
+
+void ShowMeshesMode::select_texture(uint32_t index) {
+	if (textures && index < textures->textures.size()) {
+		current_texture = index;
+		textures->textures[index].bind(&scene_drawable->pipeline, 0);
+		scene_drawable->pipeline.set_uniform(show_meshes_program->INSPECT_MODE_int, 5);
+	} else {
+		current_texture = -1U;
+		scene_drawable->pipeline.textures[0] = Scene::Drawable::Pipeline::TextureInfo();
+		scene_drawable->pipeline.set_uniform(show_meshes_program->INSPECT_MODE_int, 0);
+	}
+}
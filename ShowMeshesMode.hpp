@@ -5,14 +5,18 @@
  * ShowMeshesMode exists to show the contents of MeshBuffers; this can be useful
  * if, e.g., you aren't sure if things are being exported properly.
  *
+ * If given a TextureSet, 'T' cycles through drawing the mesh with each of
+ * its textures (e.g., to check texture coordinates against a texture).
+ *
  */
 
 #include "Mode.hpp"
 #include "Scene.hpp"
 #include "Mesh.hpp"
+#include "Texture.hpp"
 
 struct ShowMeshesMode : Mode {
-	ShowMeshesMode(MeshBuffer const &buffer);
+	ShowMeshesMode(MeshBuffer const &buffer, TextureSet const *textures = nullptr);
 	virtual ~ShowMeshesMode();
 
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
@@ -31,11 +35,18 @@ struct ShowMeshesMode : Mode {
 	MeshBuffer const &buffer;
 
 	//currently selected mesh:
+	MeshID current_mesh_id = MeshBuffer::InvalidMeshID; //(by id, not name: a file may repeat a name)
 	std::string current_mesh_name = "";
 	glm::vec3 current_mesh_min = glm::vec3(0.0f);
 	glm::vec3 current_mesh_max = glm::vec3(0.0f);
 	void select_prev_mesh();
 	void select_next_mesh();
+	void select_mesh(MeshID id); //(clears the selection if id is out of range)
+
+	//textures to try on the mesh (may be null):
+	TextureSet const *textures = nullptr;
+	uint32_t current_texture = -1U; //index in textures->textures, or -1U for none
+	void select_texture(uint32_t index); //(out of range => untextured)
 	
 	//Vertex array object used to bind mesh buffer for drawing:
 	GLuint vao = 0;
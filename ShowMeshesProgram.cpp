@@ -13,6 +13,7 @@ Load< ShowMeshesProgram > show_meshes_program(LoadTagEarly, []() -> ShowMeshesPr
 	show_meshes_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
 	show_meshes_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
 	show_meshes_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	show_meshes_program_pipeline.TEXCOORD_TRANSFORM_vec4 = ret->TEXCOORD_TRANSFORM_vec4;
 
 	return ret;
 });
@@ -25,6 +26,7 @@ ShowMeshesProgram::ShowMeshesProgram() {
 		"uniform mat4 OBJECT_TO_CLIP;\n"
 		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
 		"uniform mat3 NORMAL_TO_LIGHT;\n"
+		"uniform vec4 TEXCOORD_TRANSFORM;\n"
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
 		"in vec4 Color;\n"
@@ -38,12 +40,13 @@ ShowMeshesProgram::ShowMeshesProgram() {
 		"	position = OBJECT_TO_LIGHT * Position;\n"
 		"	normal = NORMAL_TO_LIGHT * Normal;\n"
 		"	color = Color;\n"
-		"	texCoord = TexCoord;\n"
+		"	texCoord = TexCoord * TEXCOORD_TRANSFORM.xy + TEXCOORD_TRANSFORM.zw;\n"
 		"}\n"
 	,
 		//fragment shader:
 		"#version 330\n"
 		"uniform int INSPECT_MODE;\n"
+		"uniform sampler2D TEX;\n"
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
@@ -66,6 +69,10 @@ ShowMeshesProgram::ShowMeshesProgram() {
 		"		fragColor = color;\n"
 		"	} else if (INSPECT_MODE == 4) {\n"
 		"		fragColor = vec4(grid(vec3(texCoord,0.0)), 1.0);\n"
+		"	} else if (INSPECT_MODE == 5) {\n"
+		"		vec3 l = vec3(0.0,0.0,1.0);\n"
+		"		vec4 albedo = texture(TEX, texCoord) * color;\n"
+		"		fragColor = vec4(mix(vec3(0.5), vec3(1.0), 0.5 * dot(n,l) + 0.5) * albedo.rgb, albedo.a);\n"
 		"	} else {\n"
 		"		vec3 l = vec3(0.0,0.0,1.0);\n"
 		"		fragColor = vec4(mix(vec3(0.5), vec3(1.0), 0.5 * dot(n,l) + 0.5) * color.rgb, color.a);\n"
@@ -83,8 +90,15 @@ ShowMeshesProgram::ShowMeshesProgram() {
 	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
 	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
 	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
+	TEXCOORD_TRANSFORM_vec4 = glGetUniformLocation(program, "TEXCOORD_TRANSFORM");
 
 	INSPECT_MODE_int = glGetUniformLocation(program, "INSPECT_MODE");
+	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+
+	//set TEX to always refer to texture binding zero:
+	glUseProgram(program);
+	glUniform1i(TEX_sampler2D, 0);
+	glUseProgram(0);
 }
 
 ShowMeshesProgram::~ShowMeshesProgram() {
@@ -23,11 +23,12 @@ struct ShowMeshesProgram {
 	GLuint OBJECT_TO_CLIP_mat4 = -1U;
 	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
 	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
+	GLuint TEXCOORD_TRANSFORM_vec4 = -1U; //texcoord scale (xy) and offset (zw)
 
-	GLuint INSPECT_MODE_int = -1U; //0: basic lighting; 1: position only; 2: normal only; 3: color only; 4: texcoord only
+	GLuint INSPECT_MODE_int = -1U; //0: basic lighting; 1: position only; 2: normal only; 3: color only; 4: texcoord only; 5: basic lighting, textured
 
 	//Textures:
-	//no textures used
+	//TEXTURE0 - texture that is accessed by TexCoord (in INSPECT_MODE 5)
 };
 
 extern Load< ShowMeshesProgram > show_meshes_program;
@@ -1,5 +1,6 @@
 #include "ShowSceneMode.hpp"
 #include "DrawLines.hpp"
+#include "GPUProfiler.hpp"
 
 #include <iostream>
 
@@ -85,15 +86,20 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 
 
 	//--- actual drawing ---
-	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	{ GPUProfiler::Pass pass("clear");
+		glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
 	glDisable(GL_BLEND);
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
-	scene.draw(*scene_camera);
+	{ GPUProfiler::Pass pass("scene");
+		scene.draw(*scene_camera);
+	}
 
 	{ //decorate with some lines:
+		GPUProfiler::Pass pass("lines");
 		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->make_world_to_local()));
 		for (auto &transform : scene.transforms) {
 			glm::mat4 local_to_world = transform.make_local_to_world();
@@ -0,0 +1,126 @@
+#include "StreamBuffer.hpp"
+
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+StreamBuffer stream_buffer;
+
+GLuint StreamBuffer::gl_buffer() {
+	if (buffer == 0) {
+		glGenBuffers(1, &buffer);
+		capacity = InitialCapacity;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	return buffer;
+}
+
+GLintptr StreamBuffer::write(void const *data, GLsizeiptr size, GLsizeiptr alignment) {
+	assert(size > 0);
+	assert(alignment > 0);
+	gl_buffer();
+
+	if (size > capacity) {
+		//too big to ever fit: orphan the old storage (in-flight draws keep using it) and start over with a larger ring:
+		for (auto &f : in_flight) glDeleteSync(f.fence);
+		in_flight.clear();
+		while (capacity < size) capacity *= 2;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		head = frame_begin = 0;
+		frame_used = 0;
+		grows += 1;
+	}
+
+	//find a spot:
+	GLsizeiptr offset = (head + alignment - 1) / alignment * alignment;
+	if (offset + size > capacity) offset = 0; //wrap around
+	GLsizeiptr advance = (offset >= head ? offset - head : capacity - head + offset) + size;
+
+	//if this frame alone has gone all the way around the ring, fence what it has written so far:
+	// (so the wait below stalls until the GPU catches up, rather than overwriting data still to be drawn)
+	if (frame_used + advance > capacity) {
+		fence_current();
+	}
+
+	wait_for(offset, offset + size);
+
+	//copy data:
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	void *ptr = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+	if (ptr) {
+		std::memcpy(ptr, data, size);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	} else {
+		//(shouldn't happen, but mapping is allowed to fail)
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	head = offset + size;
+	frame_used += advance;
+
+	return offset;
+}
+
+void StreamBuffer::end_frame() {
+	fence_current();
+	retire();
+}
+
+void StreamBuffer::fence_current() {
+	if (frame_used == 0) return;
+	Fenced f;
+	f.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	f.begin = frame_begin;
+	f.end = head;
+	f.full = (frame_used >= capacity); //(a frame that fills the ring exactly ends where it began)
+	in_flight.emplace_back(f);
+	frame_begin = head;
+	frame_used = 0;
+}
+
+void StreamBuffer::wait_for(GLsizeiptr begin, GLsizeiptr end) {
+	auto overlaps = [&](Fenced const &f) {
+		if (f.full) return true;
+		if (f.begin == f.end) return false;
+		if (f.begin < f.end) return f.begin < end && begin < f.end;
+		//wrapped range [f.begin,capacity) + [0,f.end):
+		return begin < f.end || f.begin < end;
+	};
+
+	//ranges are recycled in order, so waiting for the newest overlapping range frees all older ones too:
+	auto newest = in_flight.end();
+	for (auto f = in_flight.begin(); f != in_flight.end(); ++f) {
+		if (overlaps(*f)) newest = f;
+	}
+	if (newest == in_flight.end()) return;
+
+	GLenum result = glClientWaitSync(newest->fence, 0, 0);
+	if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+		waits += 1;
+		do {
+			result = glClientWaitSync(newest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); //(1s; loops until done)
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	++newest;
+	for (auto f = in_flight.begin(); f != newest; ++f) {
+		glDeleteSync(f->fence);
+	}
+	in_flight.erase(in_flight.begin(), newest);
+}
+
+void StreamBuffer::retire() {
+	while (!in_flight.empty()) {
+		GLenum result = glClientWaitSync(in_flight.front().fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+		glDeleteSync(in_flight.front().fence);
+		in_flight.pop_front();
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * StreamBuffer is a ring of vertex data for immediate-mode drawing (DrawLines, debug
+ * overlays, ...) that is rewritten every frame.
+ *
+ * Each write() is copied into the next free range of one big buffer object, mapped
+ * with GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT so the driver never
+ * has to reallocate storage or wait on earlier draws. Ranges are recycled once the
+ * fence placed by end_frame() shows the GPU is done with them.
+ *
+ * Usage:
+ *  //when drawing:
+ *  GLintptr offset = stream_buffer.write(verts.data(), verts.size() * sizeof(verts[0]), sizeof(verts[0]));
+ *  //...draw from stream_buffer.gl_buffer() starting at 'offset'...
+ *
+ *  //in the main loop, after everything has been drawn:
+ *  stream_buffer.end_frame();
+ *
+ */
+
+#include "GL.hpp"
+
+#include <cstdint>
+#include <deque>
+
+struct StreamBuffer {
+	//copy 'size' bytes into the ring (at an offset that is a multiple of 'alignment'):
+	// returns the offset of the data within gl_buffer()
+	GLintptr write(void const *data, GLsizeiptr size, GLsizeiptr alignment = 16);
+
+	//mark the end of a frame -- the data written since the previous call is recycled once the GPU has used it:
+	void end_frame();
+
+	//the buffer object data is written to (created on first use, since this lives at global scope):
+	// n.b. the name stays the same if the ring grows, so vertex array objects may refer to it
+	GLuint gl_buffer();
+
+	//--- internals ---
+	GLuint buffer = 0;
+	GLsizeiptr capacity = 0;
+	GLsizeiptr head = 0; //next free byte
+	GLsizeiptr frame_begin = 0; //first byte written this frame
+	GLsizeiptr frame_used = 0; //bytes written (including alignment padding and wrap-around) this frame
+
+	struct Fenced {
+		GLsync fence = 0;
+		GLsizeiptr begin = 0, end = 0; //range covered (may wrap around: end < begin)
+		bool full = false; //covers the whole ring (begin == end, but not empty)
+	};
+	std::deque< Fenced > in_flight; //oldest first
+
+	enum : uint32_t {
+		InitialCapacity = 1 << 20, //bytes
+	};
+
+	void fence_current(); //put a fence after everything written so far this frame
+	void wait_for(GLsizeiptr begin, GLsizeiptr end); //wait until no in-flight range overlaps [begin,end)
+	void retire(); //drop in-flight ranges whose fences have signaled (does not wait)
+
+	//stats:
+	uint64_t waits = 0; //number of times write() had to wait on the GPU
+	uint64_t grows = 0; //number of times the ring had to grow
+};
+
+extern StreamBuffer stream_buffer;
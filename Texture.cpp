@@ -0,0 +1,403 @@
+#include "Texture.hpp"
+
+#include "load_save_png.hpp"
+#include "ThreadPool.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	//"skyline" rectangle packer -- tracks the top edge of the packed area as a list of horizontal segments,
+	// and puts each new rectangle where it will sit lowest:
+	struct Skyline {
+		Skyline(uint32_t width_, uint32_t height_) : width(width_), height(height_) {
+			segments.emplace_back(Segment{0, 0, width});
+		}
+		uint32_t width, height;
+		struct Segment {
+			uint32_t x, y, w;
+		};
+		std::vector< Segment > segments; //(sorted by x, covering [0,width))
+
+		//find a place for a (size.x x size.y) rectangle; returns false if there is no room:
+		bool insert(glm::uvec2 size, glm::uvec2 *at) {
+			uint32_t best = -1U;
+			uint32_t best_y = -1U;
+			uint32_t best_w = -1U;
+			for (uint32_t i = 0; i < segments.size(); ++i) {
+				if (segments[i].x + size.x > width) break;
+				//the rectangle rests on the highest segment under it:
+				uint32_t y = 0;
+				uint32_t left = size.x;
+				for (uint32_t j = i; left > 0; ++j) {
+					y = std::max(y, segments[j].y);
+					left -= std::min(left, segments[j].w);
+				}
+				if (y + size.y > height) continue;
+				//(ties go to the narrower segment, which wastes less of the wider ones)
+				if (y < best_y || (y == best_y && segments[i].w < best_w)) {
+					best = i;
+					best_y = y;
+					best_w = segments[i].w;
+				}
+			}
+			if (best == -1U) return false;
+
+			*at = glm::uvec2(segments[best].x, best_y);
+
+			//replace the segments under the rectangle with its top edge:
+			Segment top{segments[best].x, best_y + size.y, size.x};
+			uint32_t end = top.x + top.w;
+			uint32_t covered = best;
+			while (covered < segments.size() && segments[covered].x < end) {
+				uint32_t segment_end = segments[covered].x + segments[covered].w;
+				if (segment_end > end) {
+					//(partly covered; keep the rest)
+					segments[covered].x = end;
+					segments[covered].w = segment_end - end;
+					break;
+				}
+				covered += 1;
+			}
+			segments.erase(segments.begin() + best, segments.begin() + covered);
+			segments.insert(segments.begin() + best, top);
+
+			//merge neighbors at the same height:
+			for (uint32_t i = 0; i + 1 < segments.size(); ) {
+				if (segments[i].y == segments[i+1].y) {
+					segments[i].w += segments[i+1].w;
+					segments.erase(segments.begin() + i + 1);
+				} else {
+					i += 1;
+				}
+			}
+			return true;
+		}
+
+		//height actually used:
+		uint32_t used_height() const {
+			uint32_t h = 0;
+			for (auto const &segment : segments) h = std::max(h, segment.y);
+			return h;
+		}
+	};
+
+	//does an image this size go in an atlas page?
+	bool fits_atlas(glm::uvec2 size) {
+		return size.x <= TextureSet::AtlasMaxSize && size.y <= TextureSet::AtlasMaxSize;
+	}
+
+	//space taken in a page by an image with its padding, rounded up to multiples of 4
+	// (so that images start on texel boundaries in each of the AtlasLevels levels):
+	glm::uvec2 atlas_footprint(glm::uvec2 size) {
+		return ((size + 2U * uint32_t(TextureSet::AtlasPadding)) + 3U) / 4U * 4U;
+	}
+
+	//append mipmap levels to an image, stopping at 'max_levels' levels (or 1x1):
+	void build_mipmaps(TextureSet::Image *image_, uint32_t max_levels) {
+		auto &image = *image_;
+		while (image.levels.size() < max_levels) {
+			glm::uvec2 size = image.sizes.back();
+			if (size.x == 1 && size.y == 1) break;
+			std::vector< glm::u8vec4 > next;
+			TextureSet::downsample(size, image.levels.back().data(), &next);
+			image.levels.emplace_back(std::move(next));
+			image.sizes.emplace_back(glm::max(size / 2U, glm::uvec2(1)));
+		}
+	}
+}
+
+void Texture::bind(Scene::Drawable::Pipeline *pipeline, uint32_t slot) const {
+	assert(pipeline);
+	if (slot >= Scene::Drawable::Pipeline::TextureCount) {
+		throw std::runtime_error("Texture slot " + std::to_string(slot) + " is past the end of the pipeline's texture table.");
+	}
+	pipeline->textures[slot].texture = texture;
+	pipeline->textures[slot].target = target;
+	if (slot == 0) pipeline->texcoord_transform = texcoord_transform;
+}
+
+TextureSet::TextureSet(std::vector< std::string > const &filenames, uint32_t flags_) : flags(flags_) {
+	names.reserve(filenames.size());
+	for (auto const &filename : filenames) {
+		names.emplace_back(std::filesystem::path(filename).stem().string());
+	}
+	textures.resize(filenames.size());
+	pending.resize(filenames.size());
+	sources.resize(filenames.size());
+	for (uint32_t i = 0; i < sources.size(); ++i) {
+		sources[i] = i;
+	}
+	placements.assign(filenames.size(), Placement());
+
+	//work is spread over worker threads one image per job;
+	// errors are collected rather than thrown, since jobs run on worker threads:
+	std::vector< std::string > errors(filenames.size());
+	auto throw_errors = [&]() {
+		for (uint32_t i = 0; i < filenames.size(); ++i) {
+			if (!errors[i].empty()) throw std::runtime_error("Failed to load texture '" + filenames[i] + "': " + errors[i]);
+		}
+	};
+
+	//with Atlas, read sizes first, so that images can be packed and then decoded straight into their pages:
+	if (flags & Atlas) {
+		ThreadPool::shared().parallel_for(uint32_t(filenames.size()), 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				try {
+					textures[i].size = load_png_size(filenames[i]);
+				} catch (std::exception &e) {
+					errors[i] = e.what();
+				}
+			}
+		});
+		throw_errors();
+		pack_atlas();
+	}
+
+	//decode (and downsample):
+	ThreadPool::shared().parallel_for(uint32_t(filenames.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			try {
+				glm::uvec2 size;
+				if (placements[i].image != -1U) {
+					//into its atlas page (which has room for exactly the size read above):
+					Image &page = pending[placements[i].image];
+					uint32_t stride = page.sizes[0].x;
+					glm::uvec2 at = placements[i].at + uint32_t(AtlasPadding);
+					load_png(filenames[i], &size, [&](glm::uvec2 got) {
+						if (got != textures[i].size) throw std::runtime_error("image changed size while loading");
+						return page.levels[0].data() + size_t(at.y) * stride + at.x;
+					}, stride, LowerLeftOrigin);
+					pad_atlas_image(i);
+				} else {
+					//into its own texture:
+					Image &image = pending[i];
+					image.levels.emplace_back();
+					load_png(filenames[i], &size, &image.levels.back(), LowerLeftOrigin);
+					image.sizes.emplace_back(size);
+					if (size.x == 0 || size.y == 0) throw std::runtime_error("image is empty");
+					if (!(flags & (MipmapsGPU | NoMipmaps))) {
+						build_mipmaps(&image, -1U);
+					}
+					textures[i].size = size;
+				}
+			} catch (std::exception &e) {
+				errors[i] = e.what();
+			}
+		}
+	});
+	throw_errors();
+
+	if (atlas_pages) finish_atlas();
+
+	if (!(flags & DeferUpload)) upload();
+}
+
+void TextureSet::pack_atlas() {
+	//pack tallest first (the usual skyline heuristic):
+	std::vector< uint32_t > order;
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		if (fits_atlas(textures[i].size)) order.emplace_back(i);
+	}
+	if (order.empty()) return;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		glm::uvec2 sa = atlas_footprint(textures[a].size);
+		glm::uvec2 sb = atlas_footprint(textures[b].size);
+		if (sa.y != sb.y) return sa.y > sb.y;
+		return sa.x > sb.x;
+	});
+
+	//place each image on the first page with room for it (starting a new page when none has room):
+	std::vector< Skyline > pages;
+	std::vector< uint32_t > page_of(textures.size(), -1U);
+	for (uint32_t i : order) {
+		glm::uvec2 size = atlas_footprint(textures[i].size);
+		uint32_t page = 0;
+		while (page < pages.size() && !pages[page].insert(size, &placements[i].at)) ++page;
+		if (page == pages.size()) {
+			pages.emplace_back(AtlasPageSize, AtlasPageSize);
+			if (!pages.back().insert(size, &placements[i].at)) throw std::runtime_error("Image doesn't fit in an empty atlas page.");
+		}
+		page_of[i] = page;
+	}
+
+	//make (blank) pages, trimmed to the height used:
+	uint32_t first_page = uint32_t(pending.size());
+	pending.resize(first_page + pages.size());
+	for (uint32_t p = 0; p < pages.size(); ++p) {
+		Image &image = pending[first_page + p];
+		image.sizes.emplace_back(AtlasPageSize, std::max(4U, pages[p].used_height()));
+		image.levels.emplace_back(size_t(image.sizes[0].x) * image.sizes[0].y, glm::u8vec4(0));
+		image.max_levels = (flags & NoMipmaps ? 1 : uint32_t(AtlasLevels));
+	}
+	atlas_pages = uint32_t(pages.size());
+
+	for (uint32_t i : order) {
+		placements[i].image = first_page + page_of[i];
+		sources[i] = placements[i].image;
+
+		glm::uvec2 page_size = pending[placements[i].image].sizes[0];
+		glm::vec2 scale = glm::vec2(textures[i].size) / glm::vec2(page_size);
+		glm::vec2 offset = glm::vec2(placements[i].at + uint32_t(AtlasPadding)) / glm::vec2(page_size);
+		textures[i].texcoord_transform = glm::vec4(scale.x, scale.y, offset.x, offset.y);
+	}
+}
+
+void TextureSet::pad_atlas_image(uint32_t i) {
+	Placement const &placement = placements[i];
+	Image &page = pending[placement.image];
+	size_t stride = page.sizes[0].x;
+	glm::uvec2 size = textures[i].size;
+	glm::uvec2 footprint = atlas_footprint(size);
+	glm::u8vec4 *corner = page.levels[0].data() + placement.at.y * stride + placement.at.x;
+
+	//extend the image's rows left and right...
+	for (uint32_t y = AtlasPadding; y < AtlasPadding + size.y; ++y) {
+		glm::u8vec4 *row = corner + y * stride;
+		std::fill(row, row + AtlasPadding, row[AtlasPadding]);
+		std::fill(row + AtlasPadding + size.x, row + footprint.x, row[AtlasPadding + size.x - 1]);
+	}
+	//...then its first and last rows down and up:
+	glm::u8vec4 const *first = corner + AtlasPadding * stride;
+	glm::u8vec4 const *last = corner + (AtlasPadding + size.y - 1) * stride;
+	for (uint32_t y = 0; y < AtlasPadding; ++y) {
+		std::copy(first, first + footprint.x, corner + y * stride);
+	}
+	for (uint32_t y = AtlasPadding + size.y; y < footprint.y; ++y) {
+		std::copy(last, last + footprint.x, corner + y * stride);
+	}
+}
+
+void TextureSet::finish_atlas() {
+	std::vector< uint32_t > pages;
+	for (uint32_t p = 0; p < pending.size(); ++p) {
+		if (pending[p].max_levels != -1U) pages.emplace_back(p);
+	}
+
+	//mipmaps for the pages:
+	if (!(flags & (MipmapsGPU | NoMipmaps))) {
+		ThreadPool::shared().parallel_for(uint32_t(pages.size()), 1, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t p = begin; p < end; ++p) {
+				build_mipmaps(&pending[pages[p]], pending[pages[p]].max_levels);
+			}
+		});
+	}
+
+	uint32_t packed = 0;
+	size_t used_texels = 0;
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		if (placements[i].image == -1U) continue;
+		packed += 1;
+		used_texels += size_t(textures[i].size.x) * textures[i].size.y;
+	}
+	size_t page_texels = 0;
+	for (uint32_t p : pages) {
+		page_texels += size_t(pending[p].sizes[0].x) * pending[p].sizes[0].y;
+	}
+	std::cout << "Packed " << packed << " of " << textures.size() << " textures into " << atlas_pages << " atlas page(s), "
+		<< (100 * used_texels / page_texels) << "% of texels used." << std::endl;
+}
+
+TextureSet::~TextureSet() {
+}
+
+void TextureSet::upload() {
+	if (pending.empty()) return;
+
+	//one texture object per image (or atlas page):
+	std::vector< GLuint > objects(pending.size(), 0);
+	std::vector< uint32_t > object_levels(pending.size(), 0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4); //(rows of RGBA texels are always 4-byte aligned)
+	for (uint32_t i = 0; i < pending.size(); ++i) {
+		Image const &image = pending[i];
+		if (image.levels.empty()) continue; //(packed into an atlas page)
+		bool is_page = (image.max_levels != -1U);
+
+		glGenTextures(1, &objects[i]);
+		glBindTexture(GL_TEXTURE_2D, objects[i]);
+		for (uint32_t level = 0; level < image.levels.size(); ++level) {
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, image.sizes[level].x, image.sizes[level].y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.levels[level].data());
+		}
+		uint32_t levels = uint32_t(image.levels.size());
+		if ((flags & MipmapsGPU) && !(flags & NoMipmaps)) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+			levels = 1;
+			for (glm::uvec2 size = image.sizes[0]; size.x > 1 || size.y > 1; size = glm::max(size / 2U, glm::uvec2(1))) {
+				levels += 1;
+			}
+			levels = std::min(levels, image.max_levels);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		object_levels[i] = levels;
+
+		GLint wrap = (flags & Clamp || is_page ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (flags & Nearest ? GL_NEAREST : GL_LINEAR));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		textures[i].texture = objects[sources[i]];
+		textures[i].levels = object_levels[sources[i]];
+	}
+
+	GL_ERRORS();
+
+	pending.clear();
+	pending.shrink_to_fit();
+}
+
+Texture const &TextureSet::lookup(std::string_view name) const {
+	if (Texture const *texture = try_lookup(name)) return *texture;
+	throw std::runtime_error("Looking up texture '" + std::string(name) + "' that doesn't exist.");
+}
+
+Texture const *TextureSet::try_lookup(std::string_view name) const {
+	//(sets are small, so a linear search is fine)
+	for (uint32_t i = 0; i < names.size(); ++i) {
+		if (names[i] == name) return &textures[i];
+	}
+	return nullptr;
+}
+
+void TextureSet::downsample(glm::uvec2 size, glm::u8vec4 const *from, std::vector< glm::u8vec4 > *to_) {
+	assert(to_);
+	auto &to = *to_;
+	glm::uvec2 half = glm::max(size / 2U, glm::uvec2(1));
+	to.resize(size_t(half.x) * half.y);
+
+	for (uint32_t y = 0; y < half.y; ++y) {
+		//each output texel averages the box of input texels it covers (2x2, or 2x3 / 3x3 along odd edges):
+		uint32_t y0 = y * size.y / half.y;
+		uint32_t y1 = (y + 1) * size.y / half.y;
+		for (uint32_t x = 0; x < half.x; ++x) {
+			uint32_t x0 = x * size.x / half.x;
+			uint32_t x1 = (x + 1) * size.x / half.x;
+
+			//weight color by alpha, so fully transparent texels (whose color is arbitrary) don't bleed in:
+			glm::uvec3 weighted = glm::uvec3(0);
+			glm::uvec4 plain = glm::uvec4(0);
+			for (uint32_t sy = y0; sy < y1; ++sy) {
+				for (uint32_t sx = x0; sx < x1; ++sx) {
+					glm::u8vec4 const &t = from[size_t(sy) * size.x + sx];
+					weighted += glm::uvec3(t) * uint32_t(t.a);
+					plain += glm::uvec4(t);
+				}
+			}
+			uint32_t n = (x1 - x0) * (y1 - y0);
+			glm::u8vec4 &out = to[size_t(y) * half.x + x];
+			if (plain.a > 0) {
+				out = glm::u8vec4(glm::u8vec3((weighted + plain.a / 2U) / plain.a), 0);
+			} else {
+				out = glm::u8vec4(glm::u8vec3((glm::uvec3(plain) + n / 2U) / n), 0);
+			}
+			out.a = uint8_t((plain.a + n / 2U) / n);
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+/*
+ * A TextureSet loads a list of PNG files into OpenGL textures.
+ *
+ * The files are decoded (and their mipmaps built) on worker threads, all at
+ * once; only the glTexImage2D calls need the GL context. Like MeshBuffer, a
+ * TextureSet can be built with DeferUpload in the CPU stage of a two-stage
+ * Load< T > and uploaded in its GL stage:
+ *
+ * Load< TextureSet > sprites(LoadTagDefault, {}, []() {
+ *     TextureSet *set = new TextureSet({data_path("player.png"), data_path("obstacle.png")}, TextureSet::DeferUpload);
+ *     return [set]() -> TextureSet const * {
+ *         set->upload();
+ *         return set;
+ *     };
+ * });
+ *
+ * //later:
+ * sprites->lookup("player").bind(&drawable.pipeline, 0);
+ *
+ * Mipmaps are box-filtered on the CPU (weighted by alpha, so transparent
+ * texels don't darken the edges of sprites), or left to glGenerateMipmap.
+ *
+ * With the Atlas flag, small images are packed into a few shared "atlas
+ * pages" instead of getting a texture each (image sizes are read from the PNG
+ * headers first, so packed images are decoded straight into their pages). Their Texture's texcoord_transform
+ * maps [0,1] texture coordinates into the image's part of its page, and bind()
+ * copies it into the pipeline (for programs with a TEXCOORD_TRANSFORM uniform),
+ * so drawables using different sprites can share one texture binding.
+ * Since neighbors sit just past the edges of each packed image, texture
+ * coordinates of atlased textures should stay in [0,1] (no repeating).
+ *
+ * (For now only show-meshes loads textures: the game's meshes are vertex-colored
+ * and draw with LitColorTextureProgram's 1x1 white texture.)
+ */
+
+#include "GL.hpp"
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Texture {
+	GLuint texture = 0;
+	GLenum target = GL_TEXTURE_2D;
+	glm::uvec2 size = glm::uvec2(0); //of level 0 (of the image, even if it is packed into an atlas page)
+	uint32_t levels = 0; //number of mipmap levels (1 => no mipmaps)
+
+	//where the image is within 'texture': texcoord * xy + zw (identity unless the image is in an atlas page):
+	glm::vec4 texcoord_transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+	//have a pipeline bind this texture to texture unit 'slot' when drawing:
+	// (for slot 0 -- the texture TexCoord is used with -- also sets the pipeline's texcoord_transform)
+	// note: will throw if slot >= Scene::Drawable::Pipeline::TextureCount
+	void bind(Scene::Drawable::Pipeline *pipeline, uint32_t slot = 0) const;
+};
+
+struct TextureSet {
+	enum Flags : uint32_t {
+		//generate mipmaps with glGenerateMipmap during upload() instead of on the CPU:
+		MipmapsGPU = (1 << 0),
+		//only load level 0:
+		NoMipmaps = (1 << 1),
+		//magnify with nearest-neighbor filtering (e.g., for pixel art):
+		Nearest = (1 << 2),
+		//clamp texture coordinates to the edge instead of repeating:
+		Clamp = (1 << 3),
+		//do everything but the OpenGL calls, which wait for upload():
+		DeferUpload = (1 << 4),
+		//pack images of at most AtlasMaxSize x AtlasMaxSize into shared atlas pages:
+		// (Clamp is ignored for packed images; their texcoords should stay in [0,1] anyway)
+		Atlas = (1 << 5),
+	};
+
+	enum : uint32_t {
+		AtlasPageSize = 1024, //width (and maximum height) of atlas pages
+		AtlasMaxSize = 256, //larger images get their own texture
+		AtlasPadding = 4, //texels of edge color around each packed image, so filtering doesn't pick up neighbors
+		AtlasLevels = 3, //mipmap levels used for atlas pages (padding halves with each level; at level 2 it is one texel)
+	};
+
+	//decode each file (in parallel):
+	// note: will throw if any file fails to load.
+	TextureSet(std::vector< std::string > const &filenames, uint32_t flags = 0);
+	~TextureSet();
+
+	//create and fill the textures (only needed with DeferUpload; does nothing otherwise):
+	void upload();
+
+	//textures are named by their filename, without directory or extension ("player" for "dist/player.png"):
+	Texture const &lookup(std::string_view name) const; //throws if not found
+	Texture const *try_lookup(std::string_view name) const; //nullptr if not found
+
+	std::vector< Texture > textures; //(in the order the files were given)
+	std::vector< std::string > names;
+
+	uint32_t atlas_pages = 0; //number of atlas pages made (with Atlas)
+
+	//--- internals ---
+	uint32_t flags = 0;
+
+	//decoded levels of each texture object to create, kept between construction and upload():
+	// (one per image, except that packed images share their atlas page's)
+	struct Image {
+		std::vector< glm::uvec2 > sizes;
+		std::vector< std::vector< glm::u8vec4 > > levels;
+		uint32_t max_levels = -1U; //(limits glGenerateMipmap for atlas pages)
+	};
+	std::vector< Image > pending;
+	std::vector< uint32_t > sources; //textures[i] is made from pending[sources[i]]
+
+	//where each image goes in its atlas page:
+	struct Placement {
+		uint32_t image = -1U; //index of the page in pending (-1U => not packed)
+		glm::uvec2 at = glm::uvec2(0); //lower left corner of the padding around the image
+	};
+	std::vector< Placement > placements;
+	//pack images that fit (by the sizes in textures[]) into blank atlas pages, appended to pending[]:
+	void pack_atlas();
+	//fill in the padding around packed image 'i' from its edges:
+	void pad_atlas_image(uint32_t i);
+	//build the pages' mipmaps:
+	void finish_atlas();
+
+	//the next smaller mipmap level of a (w x h) image; odd edges are folded into the last texel:
+	static void downsample(glm::uvec2 size, glm::u8vec4 const *from, std::vector< glm::u8vec4 > *to);
+};
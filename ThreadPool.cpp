@@ -0,0 +1,102 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32_t count) {
+	if (count == 0) {
+		uint32_t hw = std::thread::hardware_concurrency();
+		count = (hw > 1 ? hw - 1 : 1);
+	}
+	workers.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		workers.emplace_back([this](){
+			while (true) {
+				std::function< void() > job;
+				{
+					std::unique_lock< std::mutex > lock(mutex);
+					wake.wait(lock, [this](){ return quit || !jobs.empty(); });
+					if (quit && jobs.empty()) return;
+					job = std::move(jobs.front());
+					jobs.pop_front();
+				}
+				job();
+			}
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(std::function< void() > const &job) {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.emplace_back(job);
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &fn) {
+	if (grain == 0) grain = 1;
+	if (count <= grain || workers.empty()) {
+		if (count > 0) fn(0, count);
+		return;
+	}
+
+	//state is shared with helper jobs, which may not start running until after this call returns:
+	struct State {
+		std::function< void(uint32_t, uint32_t) > fn;
+		uint32_t count = 0;
+		uint32_t chunk = 0;
+		uint32_t chunks = 0;
+		std::atomic< uint32_t > next{0};
+		std::atomic< uint32_t > done{0};
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared< State >();
+	state->fn = fn;
+	state->count = count;
+	state->chunks = std::min((count + grain - 1) / grain, 4 * (size() + 1));
+	state->chunk = (count + state->chunks - 1) / state->chunks;
+
+	//grab chunks until none are left:
+	auto work = [](State &s) {
+		while (true) {
+			uint32_t c = s.next.fetch_add(1);
+			if (c >= s.chunks) return;
+			uint32_t begin = c * s.chunk;
+			uint32_t end = std::min(s.count, begin + s.chunk);
+			if (begin < end) s.fn(begin, end);
+			if (s.done.fetch_add(1) + 1 == s.chunks) {
+				std::unique_lock< std::mutex > lock(s.mutex);
+				s.finished.notify_all();
+			}
+		}
+	};
+
+	uint32_t helpers = std::min(size(), state->chunks - 1);
+	for (uint32_t i = 0; i < helpers; ++i) {
+		run([state,work](){ work(*state); });
+	}
+
+	//the calling thread helps out, then waits for any chunks still in progress elsewhere:
+	work(*state);
+	std::unique_lock< std::mutex > lock(state->mutex);
+	state->finished.wait(lock, [&](){ return state->done.load() == state->chunks; });
+}
+
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * A small pool of worker threads for spreading CPU-heavy work (scene prep,
+ * asset decoding, ...) across cores.
+ *
+ * Jobs are plain std::function< void() >'s and must not make OpenGL calls
+ * (the GL context belongs to the main thread).
+ *
+ * parallel_for() splits an index range into chunks and blocks until all of
+ * them are done; the calling thread works on chunks too, so it is safe to
+ * call from inside a job.
+ *
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool {
+	//start 'count' worker threads (0 => one fewer than the number of hardware threads):
+	ThreadPool(uint32_t count = 0);
+	~ThreadPool();
+
+	//queue a job to be run by some worker thread:
+	void run(std::function< void() > const &job);
+
+	//call fn(begin, end) over sub-ranges of [0,count) of roughly 'grain' items each; returns when all are done:
+	// (if count <= grain, just calls fn(0,count) on the calling thread)
+	void parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &fn);
+
+	//number of worker threads:
+	uint32_t size() const { return uint32_t(workers.size()); }
+
+	//pool shared by everything that doesn't need its own (started on first use):
+	static ThreadPool &shared();
+
+	//--- internals ---
+	std::vector< std::thread > workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque< std::function< void() > > jobs;
+	bool quit = false;
+
+	ThreadPool(ThreadPool const &) = delete;
+};
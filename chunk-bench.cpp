@@ -0,0 +1,213 @@
+//chunk-bench: measures how well the chunks in a .pnct / .scene file compress and how fast they decompress,
+// and (optionally) rewrites the file with compressed chunks.
+
+#include "read_write_chunk.hpp"
+#include "MappedFile.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static void usage(char const *argv0) {
+	std::cerr << "Usage:\n\t" << argv0 << " <path/to/file.pnct|.scene> [options]\n"
+		"Options:\n"
+		"\t--levels A,B,...  zlib levels to benchmark (default: 1,6,9)\n"
+		"\t--disk-mbps N     read speed used to estimate cold load times (default: 100)\n"
+		"\t--write OUT       write a copy of the file with compressed chunks to OUT\n"
+		"\t--level N         zlib level used by --write (default: 9)\n"
+		"\t--min-saving F    only compress chunks that shrink by at least this fraction (default: 0.1)\n"
+		<< std::endl;
+}
+
+using Clock = std::chrono::high_resolution_clock;
+
+//run 'fn' repeatedly (for at least ~50ms) and return the average seconds per call:
+template< typename F >
+static double time_per_call(F const &fn) {
+	fn(); //(warm up caches)
+	uint32_t calls = 0;
+	Clock::time_point before = Clock::now();
+	double elapsed = 0.0;
+	do {
+		fn();
+		calls += 1;
+		elapsed = std::chrono::duration< double >(Clock::now() - before).count();
+	} while (elapsed < 0.05);
+	return elapsed / calls;
+}
+
+struct Chunk {
+	std::string magic;
+	std::vector< uint8_t > data; //uncompressed contents
+	bool was_compressed = false;
+};
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	//------------ command-line options ------------
+	if (argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+	std::string in_file = argv[1];
+	std::vector< int > levels = {1, 6, 9};
+	double disk_mbps = 100.0;
+	std::string out_file;
+	int write_level = 9;
+	double min_saving = 0.1;
+	for (int argi = 2; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		bool has_value = (argi + 1 < argc);
+		if (arg == "--levels" && has_value) {
+			levels.clear();
+			std::string list = argv[++argi];
+			for (size_t begin = 0; begin < list.size(); ) {
+				size_t end = list.find(',', begin);
+				if (end == std::string::npos) end = list.size();
+				levels.emplace_back(std::stoi(list.substr(begin, end - begin)));
+				begin = end + 1;
+			}
+		} else if (arg == "--disk-mbps" && has_value) {
+			disk_mbps = std::stod(argv[++argi]);
+		} else if (arg == "--write" && has_value) {
+			out_file = argv[++argi];
+		} else if (arg == "--level" && has_value) {
+			write_level = std::stoi(argv[++argi]);
+		} else if (arg == "--min-saving" && has_value) {
+			min_saving = std::stod(argv[++argi]);
+		} else {
+			std::cerr << "Unrecognized option '" << arg << "'." << std::endl;
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (disk_mbps <= 0.0) {
+		std::cerr << "Expected a positive --disk-mbps." << std::endl;
+		return 1;
+	}
+
+	//------------ read chunks ------------
+	MappedFile file(in_file);
+	std::vector< Chunk > chunks;
+	for (size_t offset = 0; offset < file.size(); ) {
+		if (file.size() - offset < 8) throw std::runtime_error("Trailing bytes after last chunk in '" + in_file + "'.");
+		Chunk chunk;
+		chunk.magic = std::string(reinterpret_cast< char const * >(file.data() + offset), 4);
+		uint32_t header;
+		std::memcpy(&header, file.data() + offset + 4, 4);
+		uint32_t stored = header & ~ChunkCompressedBit;
+		if (stored > file.size() - offset - 8) throw std::runtime_error("Chunk '" + chunk.magic + "' extends past end of '" + in_file + "'.");
+		uint8_t const *payload = file.data() + offset + 8;
+		if (header & ChunkCompressedBit) {
+			if (stored < 4) throw std::runtime_error("Failed to read compressed chunk size for chunk '" + chunk.magic + "' in '" + in_file + "'.");
+			uint32_t size = 0;
+			std::memcpy(&size, payload, 4);
+			if (!plausible_inflated_size(stored - 4, size)) throw std::runtime_error("Failed to read compressed chunk '" + chunk.magic + "' in '" + in_file + "' (uncompressed size too large for its data).");
+			chunk.data.resize(size);
+			inflate_chunk(payload + 4, stored - 4, chunk.data.data(), size);
+			chunk.was_compressed = true;
+		} else {
+			chunk.data.assign(payload, payload + stored);
+		}
+		chunks.emplace_back(std::move(chunk));
+		offset += 8 + size_t(stored);
+	}
+
+	//------------ benchmark ------------
+	std::cout << "'" << in_file << "': " << chunks.size() << " chunks, " << file.size() << " bytes on disk.\n";
+	std::cout << std::fixed << std::setprecision(1);
+
+	auto mbps = [](size_t bytes, double seconds) {
+		return bytes / (1024.0 * 1024.0) / seconds;
+	};
+
+	size_t total_raw = 0;
+	std::vector< size_t > total_compressed(levels.size(), 0);
+	std::vector< double > total_inflate(levels.size(), 0.0);
+	double total_copy = 0.0;
+
+	for (auto const &chunk : chunks) {
+		std::cout << "  " << chunk.magic << (chunk.was_compressed ? " (compressed)" : "") << ": " << chunk.data.size() << " bytes\n";
+		if (chunk.data.empty()) continue;
+		total_raw += chunk.data.size();
+
+		//baseline -- the copy an uncompressed read_chunk does:
+		std::vector< uint8_t > out(chunk.data.size());
+		double copy = time_per_call([&](){
+			std::memcpy(out.data(), chunk.data.data(), chunk.data.size());
+		});
+		total_copy += copy;
+		std::cout << "    memcpy: " << mbps(chunk.data.size(), copy) << " MB/s\n";
+
+		for (uint32_t l = 0; l < levels.size(); ++l) {
+			std::vector< uint8_t > compressed;
+			double deflate = time_per_call([&](){
+				compressed = deflate_chunk(chunk.data.data(), chunk.data.size(), levels[l]);
+			});
+			double inflate = time_per_call([&](){
+				inflate_chunk(compressed.data(), compressed.size(), out.data(), out.size());
+			});
+			if (out != chunk.data) throw std::runtime_error("Chunk '" + chunk.magic + "' didn't survive a round trip.");
+			total_compressed[l] += compressed.size();
+			total_inflate[l] += inflate;
+			std::cout << "    level " << levels[l] << ": " << compressed.size() << " bytes ("
+				<< 100.0 * compressed.size() / chunk.data.size() << "%), deflate " << mbps(chunk.data.size(), deflate)
+				<< " MB/s, inflate " << mbps(chunk.data.size(), inflate) << " MB/s\n";
+		}
+	}
+
+	//estimated cold load = time to read the bytes at disk_mbps + time to decode them:
+	auto load_ms = [&](size_t bytes, double decode) {
+		return 1000.0 * (bytes / (disk_mbps * 1024.0 * 1024.0) + decode);
+	};
+	std::cout << "Totals (estimated cold load at " << disk_mbps << " MB/s):\n";
+	std::cout << "  raw: " << total_raw << " bytes, " << load_ms(total_raw, total_copy) << " ms\n";
+	for (uint32_t l = 0; l < levels.size(); ++l) {
+		std::cout << "  level " << levels[l] << ": " << total_compressed[l] << " bytes ("
+			<< (total_raw ? 100.0 * total_compressed[l] / total_raw : 100.0) << "%), "
+			<< load_ms(total_compressed[l], total_inflate[l]) << " ms"
+			<< " (inflate " << (total_inflate[l] > 0.0 ? mbps(total_raw, total_inflate[l]) : 0.0) << " MB/s)\n";
+	}
+	std::cout.flush();
+
+	//------------ rewrite ------------
+	if (!out_file.empty()) {
+		std::ofstream out(out_file, std::ios::binary);
+		size_t bytes = 0;
+		uint32_t compressed_count = 0;
+		for (auto const &chunk : chunks) {
+			std::vector< uint8_t > compressed;
+			if (!chunk.data.empty()) compressed = deflate_chunk(chunk.data.data(), chunk.data.size(), write_level);
+			if (!chunk.data.empty() && compressed.size() + 4 <= chunk.data.size() * (1.0 - min_saving)) {
+				write_compressed_chunk(chunk.magic, chunk.data, &out, write_level);
+				bytes += 12 + compressed.size();
+				compressed_count += 1;
+			} else {
+				write_chunk(chunk.magic, chunk.data, &out);
+				bytes += 8 + chunk.data.size();
+			}
+		}
+		if (!out) throw std::runtime_error("Failed to write '" + out_file + "'.");
+		std::cout << "Wrote '" << out_file << "': " << bytes << " bytes, " << compressed_count << " of " << chunks.size() << " chunks compressed." << std::endl;
+	}
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
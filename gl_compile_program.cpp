@@ -1,10 +1,165 @@
 #include "gl_compile_program.hpp"
 
+#include "data_path.hpp"
+#include "read_write_chunk.hpp"
+#include "AssetPack.hpp"
+
+#include <SDL.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <iostream>
 
+GLProgramCacheStats gl_program_cache_stats;
+
+//Program binaries are core in OpenGL 4.1, so GL.hpp (3.3 core) doesn't declare them; they are looked up at runtime:
+namespace {
+	constexpr GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+	constexpr GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+	constexpr GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+	typedef void (APIENTRY *GetProgramBinaryFn)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	typedef void (APIENTRY *ProgramBinaryFn)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+	typedef void (APIENTRY *ProgramParameteriFn)(GLuint program, GLenum pname, GLint value);
+
+	struct ProgramCache {
+		GetProgramBinaryFn GetProgramBinary = nullptr;
+		ProgramBinaryFn ProgramBinary = nullptr;
+		ProgramParameteriFn ProgramParameteri = nullptr;
+		std::string driver; //vendor/renderer/version; part of every key
+		std::string directory;
+	};
+
+	//set up on first use (needs a current context):
+	ProgramCache const &get_cache() {
+		static ProgramCache cache;
+		static bool initialized = false;
+		if (initialized) return cache;
+		initialized = true;
+
+		auto str = [](GLenum name) -> std::string {
+			GLubyte const *s = glGetString(name);
+			return s ? reinterpret_cast< char const * >(s) : "";
+		};
+		cache.driver = str(GL_VENDOR) + "\n" + str(GL_RENDERER) + "\n" + str(GL_VERSION);
+
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		bool supported = (major > 4 || (major == 4 && minor >= 1));
+		if (!supported) {
+			GLint extensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+			for (GLint i = 0; i < extensions; ++i) {
+				GLubyte const *name = glGetStringi(GL_EXTENSIONS, GLuint(i));
+				if (name && std::strcmp(reinterpret_cast< char const * >(name), "GL_ARB_get_program_binary") == 0) {
+					supported = true;
+					break;
+				}
+			}
+		}
+		if (supported) {
+			GLint formats = 0;
+			glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+			if (formats <= 0) supported = false; //(drivers may support the API without any formats to save)
+		}
+		if (supported) {
+			cache.GetProgramBinary = reinterpret_cast< GetProgramBinaryFn >(SDL_GL_GetProcAddress("glGetProgramBinary"));
+			cache.ProgramBinary = reinterpret_cast< ProgramBinaryFn >(SDL_GL_GetProcAddress("glProgramBinary"));
+			cache.ProgramParameteri = reinterpret_cast< ProgramParameteriFn >(SDL_GL_GetProcAddress("glProgramParameteri"));
+		}
+		if (!(cache.GetProgramBinary && cache.ProgramBinary && cache.ProgramParameteri)) {
+			cache.GetProgramBinary = nullptr;
+			cache.ProgramBinary = nullptr;
+			cache.ProgramParameteri = nullptr;
+		} else {
+			cache.directory = data_path("shader-cache");
+		}
+		while (glGetError() != GL_NO_ERROR) { } //(queries above may raise errors on drivers without support)
+
+		gl_program_cache_stats.enabled = (cache.ProgramBinary != nullptr);
+		return cache;
+	}
+
+	//cache file layout:
+	// "pbk0" chunk: the key (sources + driver hash, then driver string) -- checked on load, to catch collisions
+	// "pbf0" chunk: binary format (one GLenum)
+	// "pbd0" chunk: binary data
+	std::string make_key(ProgramCache const &cache, std::string const &vertex_source, std::string const &fragment_source) {
+		std::string keyed = vertex_source + '\0' + fragment_source + cache.driver;
+		std::ostringstream key;
+		key << std::hex << std::setw(16) << std::setfill('0') << fnv1a64(reinterpret_cast< uint8_t const * >(keyed.data()), keyed.size());
+		return key.str();
+	}
+
+	GLuint load_cached(ProgramCache const &cache, std::string const &key) {
+		std::ifstream file(cache.directory + "/" + key + ".bin", std::ios::binary);
+		if (!file) return 0;
+
+		std::vector< char > stored_key;
+		std::vector< GLenum > format;
+		std::vector< char > binary;
+		try {
+			read_chunk(file, "pbk0", &stored_key);
+			read_chunk(file, "pbf0", &format);
+			read_chunk(file, "pbd0", &binary);
+		} catch (std::exception &) {
+			return 0; //(truncated or corrupt file)
+		}
+		if (std::string(stored_key.begin(), stored_key.end()) != key + "\n" + cache.driver) return 0;
+		if (format.size() != 1 || binary.empty()) return 0;
+
+		GLuint program = glCreateProgram();
+		cache.ProgramBinary(program, format[0], binary.data(), GLsizei(binary.size()));
+		GLint link_status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+		if (link_status != GL_TRUE) {
+			//drivers may refuse binaries at any time (e.g., after an update); recompile instead:
+			glDeleteProgram(program);
+			while (glGetError() != GL_NO_ERROR) { }
+			gl_program_cache_stats.rejected += 1;
+			return 0;
+		}
+		return program;
+	}
+
+	void save_cached(ProgramCache const &cache, std::string const &key, GLuint program) {
+		GLint length = 0;
+		glGetProgramiv(program, PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+
+		std::vector< char > binary(length);
+		std::vector< GLenum > format(1, 0);
+		GLsizei written = 0;
+		cache.GetProgramBinary(program, length, &written, &format[0], binary.data());
+		if (written <= 0) return;
+		binary.resize(written);
+
+		std::error_code ec;
+		std::filesystem::create_directories(cache.directory, ec);
+		//write to a temporary file and rename, so a crash (or another instance) never leaves a partial file behind:
+		std::string filename = cache.directory + "/" + key + ".bin";
+		std::string temp = filename + ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary);
+			if (!file) return; //(cache directory not writable; not a problem)
+			std::string full_key = key + "\n" + cache.driver;
+			write_chunk("pbk0", std::vector< char >(full_key.begin(), full_key.end()), &file);
+			write_chunk("pbf0", format, &file);
+			write_chunk("pbd0", binary, &file);
+			if (!file) return;
+		}
+		std::filesystem::rename(temp, filename, ec);
+	}
+}
+
 static GLuint gl_compile_shader(GLenum type, std::string const &source) {
 	GLuint shader = glCreateShader(type);
 	GLchar const *str = source.c_str();
@@ -32,6 +187,25 @@ GLuint gl_compile_program(
 	std::string const &fragment_shader_source
 	) {
 
+	auto before = std::chrono::high_resolution_clock::now();
+	auto add_time = [&before]() {
+		auto after = std::chrono::high_resolution_clock::now();
+		gl_program_cache_stats.seconds += std::chrono::duration< double >(after - before).count();
+	};
+
+	ProgramCache const &cache = get_cache();
+	std::string key;
+	if (cache.ProgramBinary) {
+		key = make_key(cache, vertex_shader_source, fragment_shader_source);
+		GLuint program = load_cached(cache, key);
+		if (program) {
+			gl_program_cache_stats.hits += 1;
+			add_time();
+			return program;
+		}
+	}
+	gl_program_cache_stats.misses += 1;
+
 	GLuint vertex_shader = gl_compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
 	GLuint fragment_shader = gl_compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
 
@@ -43,6 +217,9 @@ GLuint gl_compile_program(
 	glDeleteShader(vertex_shader);
 	glDeleteShader(fragment_shader);
 
+	//ask the driver to keep the binary around so it can be cached:
+	if (cache.ProgramParameteri) cache.ProgramParameteri(program, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	//link the shader program and throw errors if linking fails:
 	glLinkProgram(program);
 	GLint link_status = GL_FALSE;
@@ -58,5 +235,8 @@ GLuint gl_compile_program(
 		throw std::runtime_error("failed to link program");
 	}
 
+	if (cache.GetProgramBinary) save_cached(cache, key, program);
+
+	add_time();
 	return program;
 }
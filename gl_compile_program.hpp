@@ -6,6 +6,20 @@
 
 //compiles+links an OpenGL shader program from source.
 // throws on compilation error.
+// When the driver supports program binaries (GL 4.1 or ARB_get_program_binary), linked programs
+//  are cached on disk (in data_path("shader-cache/")), keyed by a hash of the sources and the
+//  driver's vendor/renderer/version strings; later runs load the binary instead of compiling.
+//  (any problem with the cache just falls back to compiling)
 GLuint gl_compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source);
+
+//program cache statistics, accumulated over all gl_compile_program calls:
+struct GLProgramCacheStats {
+	bool enabled = false; //driver supports program binaries (and the cache can be used)
+	uint32_t hits = 0; //programs loaded from the cache
+	uint32_t misses = 0; //programs compiled from source
+	uint32_t rejected = 0; //cached binaries the driver refused (counted in misses as well)
+	double seconds = 0.0; //total time spent in gl_compile_program
+};
+extern GLProgramCacheStats gl_program_cache_stats;
@@ -1,29 +1,85 @@
 #include "load_save_png.hpp"
 
+#include "AssetPack.hpp"
+
 #include <png.h>
 
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
 #include <vector>
 
 #define LOG_ERROR( X ) std::cerr << X << std::endl
 
 using std::vector;
 
-bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin);
+struct PNGSource {
+	uint8_t const *data;
+	size_t size;
+	size_t offset;
+};
+
+//where read_png puts what it decodes:
+struct PNGDestination {
+	//decode into the buffer this returns (rows row_stride texels apart; 0 => width)...
+	std::function< glm::u8vec4 *(glm::uvec2 size) > const *get_buffer = nullptr;
+	size_t row_stride = 0;
+	//...or hand over rows one at a time...
+	std::function< void(uint32_t y, glm::u8vec4 const *row) > const *on_row = nullptr;
+	//...or just read the size:
+	bool header_only = false;
+};
+
+static bool read_png(PNGSource &from, glm::uvec2 *size, PNGDestination const &to, OriginLocation origin);
 void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin);
 
+//decode straight from the mapped file or pack:
+static void read_png(std::string const &filename, glm::uvec2 *size, PNGDestination const &to, OriginLocation origin) {
+	AssetFile file(filename);
+	PNGSource source{file.data(), file.size(), 0};
+	if (!read_png(source, size, to, origin)) {
+		throw std::runtime_error("Failed to read PNG image from '" + filename + "'.");
+	}
+}
+
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
+	assert(data);
+	data->clear();
+	try {
+		load_png(filename, size, [data](glm::uvec2 size) {
+			data->resize(size_t(size.x) * size.y);
+			return data->data();
+		}, 0, origin);
+	} catch (...) {
+		data->clear();
+		throw;
+	}
+}
+
+void load_png(std::string filename, glm::uvec2 *size, std::function< glm::u8vec4 *(glm::uvec2 size) > const &get_buffer, size_t row_stride, OriginLocation origin) {
 	assert(size);
+	PNGDestination to;
+	to.get_buffer = &get_buffer;
+	to.row_stride = row_stride;
+	read_png(filename, size, to, origin);
+}
 
-	std::ifstream file(filename.c_str(), std::ios::binary);
-	if (!file) {
-		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
-	}
-	if (!load_png(file, &size->x, &size->y, data, origin)) {
-		throw std::runtime_error("Failed to read PNG image from '" + filename + "'.");
-	}
+void load_png_rows(std::string filename, glm::uvec2 *size, std::function< void(uint32_t y, glm::u8vec4 const *row) > const &on_row, OriginLocation origin) {
+	assert(size);
+	PNGDestination to;
+	to.on_row = &on_row;
+	read_png(filename, size, to, origin);
+}
+
+glm::uvec2 load_png_size(std::string filename) {
+	glm::uvec2 size;
+	PNGDestination to;
+	to.header_only = true;
+	read_png(filename, &size, to, UpperLeftOrigin);
+	return size;
 }
 
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin) {
@@ -33,11 +89,13 @@ void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, Or
 
 
 static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t length) {
-	std::istream *from = reinterpret_cast< std::istream * >(png_get_io_ptr(png_ptr));
+	PNGSource *from = reinterpret_cast< PNGSource * >(png_get_io_ptr(png_ptr));
 	assert(from);
-	if (!from->read(reinterpret_cast< char * >(data), length)) {
+	if (length > from->size - from->offset) {
 		png_error(png_ptr, "Error reading.");
 	}
+	std::memcpy(data, from->data + from->offset, length);
+	from->offset += length;
 }
 
 static void user_write_data(png_structp png_ptr, png_bytep data, png_size_t length) {
@@ -57,41 +115,49 @@ static void user_flush_data(png_structp png_ptr) {
 }
 
 
-bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin) {
-	assert(data);
-	uint32_t local_width, local_height;
-	if (width == nullptr) width = &local_width;
-	if (height == nullptr) height = &local_height;
-	*width = *height = 0;
-	data->clear();
+bool read_png(PNGSource &from, glm::uvec2 *size, PNGDestination const &to, OriginLocation origin) {
+	assert(size);
+	*size = glm::uvec2(0);
 	//..... load file ......
 	//Load a png file, as per the libpng docs:
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
 
-	png_set_read_fn(png, &from, user_read_data);
-
 	if (!png) {
 		LOG_ERROR("  cannot alloc read struct.");
 		return false;
 	}
+
+	png_set_read_fn(png, &from, user_read_data);
+
 	png_infop info = png_create_info_struct(png);
 	if (!info) {
 		LOG_ERROR("  cannot alloc info struct.");
 		png_destroy_read_struct(&png, (png_infopp)NULL, (png_infopp)NULL);
 		return false;
 	}
-	png_bytep *row_pointers = NULL;
+	//(declared before setjmp, so they are intact if libpng longjmps back here)
+	vector< png_bytep > row_pointers;
+	vector< glm::u8vec4 > scratch; //one row -- or, when handing over rows of an interlaced image, all of them
 	if (setjmp(png_jmpbuf(png))) {
 		LOG_ERROR("  png interal error.");
 		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
-		if (row_pointers != NULL) delete[] row_pointers;
-		data->clear();
 		return false;
 	}
+	//exceptions from the caller's callbacks pass through, after cleaning up:
+	auto destroy_and_rethrow = [&]() {
+		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+		throw;
+	};
+
 	//not needed with custom read/write functions: png_init_io(png, NULL);
 	png_read_info(png, info);
 	unsigned int w = png_get_image_width(png, info);
 	unsigned int h = png_get_image_height(png, info);
+	if (to.header_only) {
+		png_destroy_read_struct(&png, &info, NULL);
+		*size = glm::uvec2(w, h);
+		return true;
+	}
 	if (png_get_color_type(png, info) == PNG_COLOR_TYPE_PALETTE)
 		png_set_palette_to_rgb(png);
 	if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY || png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY_ALPHA)
@@ -103,27 +169,68 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 	if (png_get_bit_depth(png,info) == 16)
 		png_set_strip_16(png);
 	//Ok, should be 32-bit RGBA now.
+	int passes = png_set_interlace_handling(png);
 
 	png_read_update_info(png, info);
 	size_t rowbytes = png_get_rowbytes(png, info);
 	//Make sure it's the format we think it is...
 	assert(rowbytes == w*sizeof(uint32_t));
+	(void)rowbytes;
+
+	//rows come out of the file top to bottom; this is the row each one is in 'origin' order:
+	auto row_y = [&](unsigned int r) {
+		return (origin == LowerLeftOrigin ? h-1-r : r);
+	};
 
-	data->resize(w*h);
-	row_pointers = new png_bytep[h];
-	for (unsigned int r = 0; r < h; ++r) {
-		if (origin == LowerLeftOrigin) {
-			row_pointers[h-1-r] = (png_bytep)(&(*data)[r*w]);
+	if (to.on_row && passes == 1) {
+		//hand over rows as they are decoded:
+		*size = glm::uvec2(w, h);
+		scratch.resize(w);
+		for (unsigned int r = 0; r < h; ++r) {
+			png_read_row(png, (png_bytep)scratch.data(), NULL);
+			try {
+				(*to.on_row)(row_y(r), scratch.data());
+			} catch (...) {
+				destroy_and_rethrow();
+			}
+		}
+	} else {
+		//decode the whole image, with row pointers set up so that rows land in 'origin' order:
+		glm::u8vec4 *buffer = nullptr;
+		size_t stride = w;
+		if (to.on_row) {
+			scratch.resize(size_t(w) * h);
+			buffer = scratch.data();
 		} else {
-			row_pointers[r] = (png_bytep)(&(*data)[r*w]);
+			assert(to.get_buffer);
+			try {
+				buffer = (*to.get_buffer)(glm::uvec2(w, h));
+				if (!buffer) throw std::runtime_error("No buffer to decode PNG image into.");
+			} catch (...) {
+				destroy_and_rethrow();
+			}
+			if (to.row_stride != 0) stride = to.row_stride;
+		}
+		row_pointers.resize(h);
+		for (unsigned int r = 0; r < h; ++r) {
+			row_pointers[r] = (png_bytep)(buffer + size_t(row_y(r)) * stride);
+		}
+		png_read_image(png, row_pointers.data());
+
+		if (to.on_row) {
+			*size = glm::uvec2(w, h);
+			for (unsigned int r = 0; r < h; ++r) {
+				try {
+					(*to.on_row)(row_y(r), buffer + size_t(row_y(r)) * w);
+				} catch (...) {
+					destroy_and_rethrow();
+				}
+			}
 		}
 	}
-	png_read_image(png, row_pointers);
 	png_destroy_read_struct(&png, &info, NULL);
-	delete[] row_pointers;
 
-	*width = w;
-	*height = h;
+	*size = glm::uvec2(w, h);
 	return true;
 }
 
@@ -2,12 +2,32 @@
 
 #include <glm/glm.hpp>
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <stdint.h>
 
 /*
  * Load and save PNG files.
+ *
+ * Images are always decoded to 8-bit RGBA. Rows are decoded straight to where
+ * they belong for the requested origin (by ordering libpng's row pointers),
+ * so there is never a second pass to flip the image.
+ *
+ * Besides decoding into a std::vector, load_png can decode into memory the
+ * caller provides once the size is known -- e.g., part of a larger image, or a
+ * mapped pixel buffer object:
+ *
+ *  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+ *  load_png(filename, &size, [&](glm::uvec2 size) {
+ *      glBufferData(GL_PIXEL_UNPACK_BUFFER, size.x * size.y * 4, nullptr, GL_STREAM_DRAW);
+ *      return reinterpret_cast< glm::u8vec4 * >(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+ *  }, 0, LowerLeftOrigin);
+ *  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+ *  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+ *
+ * ...and load_png_rows hands over one row at a time, so huge images can be
+ * processed without ever holding all of their texels.
  */
 
 enum OriginLocation {
@@ -15,6 +35,19 @@ enum OriginLocation {
 	UpperLeftOrigin,
 };
 
-//NOTE: load_png will throw on error
+//NOTE: load_png (and friends) will throw on error
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
+
+//decode into caller-provided memory: 'get_buffer' is called with the size once the header has been read,
+// and returns where the first row (in 'origin' order) goes; rows are 'row_stride' texels apart (0 => size.x).
+// (get_buffer may throw to abandon loading)
+void load_png(std::string filename, glm::uvec2 *size, std::function< glm::u8vec4 *(glm::uvec2 size) > const &get_buffer, size_t row_stride, OriginLocation origin);
+
+//decode a row at a time: 'on_row' is called for each row, in file order (top to bottom), with 'y' the row's index in 'origin' order;
+// 'row' is only valid during the call. 'size' is set before the first row.
+// (interlaced images can't be decoded a row at a time, so they are decoded whole and then handed over)
+void load_png_rows(std::string filename, glm::uvec2 *size, std::function< void(uint32_t y, glm::u8vec4 const *row) > const &on_row, OriginLocation origin);
+
+//read just the size of an image from its header:
+glm::uvec2 load_png_size(std::string filename);
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin);
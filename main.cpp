@@ -13,6 +13,18 @@
 //for screenshots:
 #include "load_save_png.hpp"
 
+//for GPU timing overlay:
+#include "GPUProfiler.hpp"
+#include "StreamBuffer.hpp"
+#include "ScreenCapture.hpp"
+#include "DynamicResolution.hpp"
+#include "FramePipeline.hpp"
+#include "AssetPack.hpp"
+#include "HotReload.hpp"
+#include "BufferUpload.hpp"
+#include "data_path.hpp"
+#include "gl_compile_program.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -22,6 +34,8 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <cstdlib>
+#include <fstream>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -42,6 +56,43 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command-line options ------------
+
+	std::string gpu_profile_csv = ""; //if non-empty, write per-frame GPU pass timings here
+	std::string record_prefix = "capture-"; //frames recorded with F12 (or --record) are saved with this prefix
+	uint32_t record_every = 1; //...keeping one of every this many frames
+	ScreenCapture::Format record_format = ScreenCapture::PNG;
+	bool record_at_start = false;
+	uint32_t frames_in_flight = frame_pipeline.frames_in_flight; //how far the CPU may run ahead of the GPU
+	float dynamic_resolution_ms = 0.0f; //if positive, scale the 3D view's resolution to keep it under this GPU time
+	bool hot_reload_assets = false; //reload meshes and scenes when their files change
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--gpu-profile" && i + 1 < argc) {
+			gpu_profile_csv = argv[i+1];
+			i += 1;
+		} else if (arg == "--frames-in-flight" && i + 1 < argc) {
+			frames_in_flight = uint32_t(std::max(1, std::min(int(FramePipeline::MaxFramesInFlight), std::atoi(argv[i+1]))));
+			i += 1;
+		} else if (arg == "--dynamic-resolution" && i + 1 < argc) {
+			dynamic_resolution_ms = float(std::atof(argv[i+1]));
+			i += 1;
+		} else if (arg == "--record" && i + 1 < argc) {
+			record_prefix = argv[i+1];
+			record_at_start = true;
+			i += 1;
+		} else if (arg == "--record-every" && i + 1 < argc) {
+			record_every = std::max(1, std::atoi(argv[i+1]));
+			i += 1;
+		} else if (arg == "--record-raw") {
+			record_format = ScreenCapture::Raw;
+		} else if (arg == "--hot-reload") {
+			hot_reload_assets = true;
+		} else {
+			std::cerr << "Ignoring unrecognized command-line option '" << arg << "'." << std::endl;
+		}
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -103,8 +154,35 @@ int main(int argc, char **argv) {
 	//SDL_ShowCursor(SDL_DISABLE);
 
 	//------------ load assets --------------
+	{ //assets come from dist/assets.pack if it exists (see scenes/pack-assets.py), otherwise from loose files:
+		//(but not when hot reloading, which watches the loose files)
+		std::string pack = data_path("assets.pack");
+		if (!hot_reload_assets && std::ifstream(pack, std::ios::binary)) mount_asset_pack(pack);
+	}
+
 	call_load_functions();
 
+	if (gl_program_cache_stats.enabled) {
+		std::cout << "Shader programs: " << gl_program_cache_stats.hits << " from cache, " << gl_program_cache_stats.misses << " compiled";
+		if (gl_program_cache_stats.rejected) std::cout << " (" << gl_program_cache_stats.rejected << " cached binaries rejected by driver)";
+		std::cout << "; " << gl_program_cache_stats.seconds * 1000.0 << " ms." << std::endl;
+	}
+
+	if (gpu_profile_csv != "") {
+		gpu_profiler.start_csv(gpu_profile_csv);
+		std::cout << "Writing GPU pass timings to '" << gpu_profile_csv << "'." << std::endl;
+	}
+
+	frame_pipeline.frames_in_flight = frames_in_flight;
+
+	hot_reload.enabled = hot_reload_assets;
+
+	if (dynamic_resolution_ms > 0.0f) {
+		dynamic_resolution.enabled = true;
+		dynamic_resolution.budget_ms = dynamic_resolution_ms;
+		std::cout << "Scaling 3D resolution to keep clear+scene under " << dynamic_resolution_ms << " ms of GPU time." << std::endl;
+	}
+
 	//------------ create game mode + make current --------------
 	Mode::set_current(std::make_shared< PlayMode >());
 
@@ -125,6 +203,10 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	if (record_at_start) {
+		screen_capture.start_recording(record_prefix, record_every, record_format);
+	}
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
@@ -143,25 +225,25 @@ int main(int argc, char **argv) {
 				} else if (evt.type == SDL_QUIT) {
 					Mode::set_current(nullptr);
 					break;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F1) {
+					// --- GPU timing overlay toggle ---
+					gpu_profiler.show_overlay = !gpu_profiler.show_overlay;
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GL_GetDrawableSize(window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
-					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+					//(saved in the background once the next frame has been drawn)
+					screen_capture.screenshot("screenshot.png");
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F12) {
+					// --- frame recording toggle ---
+					if (screen_capture.recording()) screen_capture.stop_recording();
+					else screen_capture.start_recording(record_prefix, record_every, record_format);
 				}
 			}
 			if (!Mode::current) break;
 		}
 
+		//swap in any assets that have been rebuilt since they changed on disk:
+		hot_reload.update();
+
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
@@ -177,16 +259,28 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			//(waits here -- not before update() -- if the GPU is too far behind)
+			frame_pipeline.begin_frame();
+			gpu_profiler.begin_frame();
 			Mode::current->draw(drawable_size);
+			gpu_profiler.draw_overlay(drawable_size);
+			gpu_profiler.end_frame();
+			stream_buffer.end_frame(); //(recycles immediate-mode vertex data once the GPU is done with it)
+			screen_capture.end_frame(drawable_size);
 		}
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
+		//Queue the frame for display (frame_pipeline, not the swap, decides how far ahead of the GPU the next frame may start):
 		SDL_GL_SwapWindow(window);
+		frame_pipeline.end_frame();
 	}
 
 
 	//------------  teardown ------------
+	hot_reload.finish();
+	screen_capture.finish();
+	frame_pipeline.finish();
+	buffer_upload.finish();
+	print_lazy_load_report(std::cout);
 
 	SDL_GL_DeleteContext(context);
 	context = 0;
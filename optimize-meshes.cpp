@@ -0,0 +1,70 @@
+//optimize-meshes: does the expensive parts of MeshBuffer loading (vertex dedup, cache reordering, quantization, LODs) once, offline,
+// and writes the result as a '.pnct' file that the game can load with no flags.
+
+#include "Mesh.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static void usage(char const *argv0) {
+	std::cerr << "Usage:\n\t" << argv0 << " <path/to/in.pnct> <path/to/out.pnct> [options]\n"
+		"Merges identical vertices and reorders each mesh's triangles for the post-transform vertex cache (writing an 'ind0' index chunk).\n"
+		"Options:\n"
+		"\t--compact         store vertices in the compact 'pnc2' format\n"
+		"\t--quantize        also store positions as 16-bit values relative to each mesh's bounds ('pnq2' + 'pqd0' chunks)\n"
+		"\t--lods            also build simplified versions of each mesh ('lod0' chunk)\n"
+		<< std::endl;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	//------------ command-line options ------------
+	if (argc < 3) {
+		usage(argv[0]);
+		return 1;
+	}
+	std::string in_file = argv[1];
+	std::string out_file = argv[2];
+	uint32_t flags = MeshBuffer::OptimizeIndices;
+	for (int argi = 3; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--compact") {
+			flags |= MeshBuffer::CompactVertices;
+		} else if (arg == "--quantize") {
+			flags |= MeshBuffer::QuantizePositions;
+		} else if (arg == "--lods") {
+			flags |= MeshBuffer::GenerateLODs;
+		} else {
+			std::cerr << "Unrecognized option '" << arg << "'." << std::endl;
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	//------------ process and write ------------
+	//(DeferUpload: no OpenGL context needed, and the processed data stays around for write())
+	MeshBuffer buffer(in_file, flags | MeshBuffer::DeferUpload | MeshBuffer::PrintStats);
+
+	std::ofstream out(out_file, std::ios::binary);
+	buffer.write(out);
+	if (!out) throw std::runtime_error("Failed to write '" + out_file + "'.");
+	std::cout << "Wrote '" << out_file << "' (" << buffer.mesh_count() << " meshes)." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
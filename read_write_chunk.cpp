@@ -0,0 +1,84 @@
+#include "read_write_chunk.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+
+//n.b. chunk sizes are 32-bit, so they always fit in zlib's (uInt) avail_in / avail_out.
+
+namespace {
+	//run inflate until the stream ends; 'refill' supplies more input whenever zlib runs out (returns false when there is none):
+	template< typename Refill >
+	void inflate_all(z_stream &stream, void *to, size_t to_size, Refill const &refill) {
+		//(zlib won't make progress with no room for output, so an empty chunk inflates into a scratch byte)
+		Bytef scratch = 0;
+		stream.next_out = (to_size ? reinterpret_cast< Bytef * >(to) : &scratch);
+		stream.avail_out = uInt(to_size ? to_size : 1);
+
+		int result = Z_OK;
+		while (result == Z_OK) {
+			if (stream.avail_in == 0 && !refill(stream)) break;
+			result = inflate(&stream, Z_NO_FLUSH);
+			if (result == Z_BUF_ERROR && stream.avail_out == 0) break; //(more data than expected)
+		}
+		std::string message = (stream.msg ? stream.msg : "");
+		size_t produced = (to_size ? to_size : 1) - stream.avail_out;
+		inflateEnd(&stream);
+
+		if (result == Z_DATA_ERROR || result == Z_MEM_ERROR || result == Z_NEED_DICT) {
+			throw std::runtime_error("Failed to decompress chunk" + (message.empty() ? std::string() : ": " + message));
+		}
+		if (result != Z_STREAM_END || produced != to_size) {
+			throw std::runtime_error("Compressed chunk is truncated or doesn't match its size");
+		}
+	}
+}
+
+void inflate_chunk(std::istream &from, size_t compressed_size, void *to, size_t to_size) {
+	z_stream stream{};
+	if (inflateInit(&stream) != Z_OK) throw std::runtime_error("Failed to initialize zlib");
+
+	//read through a small buffer rather than holding the whole compressed chunk:
+	std::vector< Bytef > buffer(std::min< size_t >(compressed_size, 64 * 1024));
+	size_t left = compressed_size;
+	bool read_failed = false;
+	try {
+		inflate_all(stream, to, to_size, [&](z_stream &s) {
+			if (left == 0) return false;
+			size_t amount = std::min(left, buffer.size());
+			if (!from.read(reinterpret_cast< char * >(buffer.data()), amount)) {
+				read_failed = true;
+				return false;
+			}
+			left -= amount;
+			s.next_in = buffer.data();
+			s.avail_in = uInt(amount);
+			return true;
+		});
+	} catch (std::runtime_error &) {
+		if (!read_failed) throw;
+	}
+	if (read_failed) throw std::runtime_error("Failed to read compressed chunk data");
+
+	//skip any trailing bytes zlib didn't need, so 'from' is positioned at the next chunk:
+	if (left) from.seekg(left, std::ios::cur);
+}
+
+void inflate_chunk(uint8_t const *from, size_t compressed_size, void *to, size_t to_size) {
+	z_stream stream{};
+	if (inflateInit(&stream) != Z_OK) throw std::runtime_error("Failed to initialize zlib");
+
+	stream.next_in = const_cast< Bytef * >(from);
+	stream.avail_in = uInt(compressed_size);
+	inflate_all(stream, to, to_size, [](z_stream &) { return false; });
+}
+
+std::vector< uint8_t > deflate_chunk(void const *from, size_t size, int level) {
+	uLongf bound = compressBound(uLong(size));
+	std::vector< uint8_t > out(bound);
+	if (compress2(out.data(), &bound, reinterpret_cast< Bytef const * >(from), uLong(size), level) != Z_OK) {
+		throw std::runtime_error("Failed to compress chunk");
+	}
+	out.resize(bound);
+	return out;
+}
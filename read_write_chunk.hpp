@@ -4,12 +4,44 @@
 #include <vector>
 #include <stdexcept>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
 
 //helper function that reads an array of structures preceded by a simple header:
 //Expected format:
 // |ma|gi|c.|..| <-- four byte "magic number"
 // |sz|sz|sz|sz| <-- four byte (native endian) size
 // |TT...TT| * (sz/sizeof(TT)) <-- enough T structures to make up sz bytes
+//
+//Chunks may also be zlib-compressed (see write_compressed_chunk), in which case:
+// |ma|gi|c.|..| <-- four byte "magic number" (same as uncompressed)
+// |sz|sz|sz|sz| <-- four byte size of what follows, with ChunkCompressedBit set
+// |us|us|us|us| <-- four byte size of the uncompressed data
+// |zz...zz| <-- (sz - 4) bytes of zlib stream
+
+enum : uint32_t {
+	ChunkCompressedBit = 0x80000000u,
+	//deflate can't shrink data by more than about 1032:1, so a compressed chunk claiming a bigger
+	// uncompressed size is corrupt (checked before anything is allocated for it):
+	ChunkMaxInflateRatio = 1032,
+};
+
+//could 'compressed_size' bytes of zlib stream inflate to 'size' bytes?
+inline bool plausible_inflated_size(size_t compressed_size, size_t size) {
+	return uint64_t(size) <= uint64_t(compressed_size) * ChunkMaxInflateRatio;
+}
+
+//zlib helpers (read_write_chunk.cpp); all throw on malformed data or size mismatch:
+//inflate 'compressed_size' bytes read from a stream into exactly 'to_size' bytes at 'to' (reads through a small fixed buffer):
+void inflate_chunk(std::istream &from, size_t compressed_size, void *to, size_t to_size);
+//inflate from memory:
+void inflate_chunk(uint8_t const *from, size_t compressed_size, void *to, size_t to_size);
+//compress 'size' bytes (level: 1 = fastest ... 9 = smallest):
+std::vector< uint8_t > deflate_chunk(void const *from, size_t size, int level);
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *to_) {
@@ -30,6 +62,24 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 		throw std::runtime_error("Unexpected magic number in chunk");
 	}
 
+	if (header.size & ChunkCompressedBit) {
+		//decompress straight into the destination:
+		uint32_t stored = header.size & ~ChunkCompressedBit;
+		uint32_t size = 0;
+		if (stored < 4 || !from.read(reinterpret_cast< char * >(&size), 4)) {
+			throw std::runtime_error("Failed to read compressed chunk size");
+		}
+		if (!plausible_inflated_size(stored - 4, size)) {
+			throw std::runtime_error("Failed to read compressed chunk (uncompressed size too large for its data)");
+		}
+		if (size % sizeof(T) != 0) {
+			throw std::runtime_error("Size of chunk not divisible by element size");
+		}
+		to.resize(size / sizeof(T));
+		inflate_chunk(from, stored - 4, to.data(), size);
+		return;
+	}
+
 	if (header.size % sizeof(T) != 0) {
 		throw std::runtime_error("Size of chunk not divisible by element size");
 	}
@@ -40,6 +90,17 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	}
 }
 
+//helper function that checks if the next chunk in a stream has a given magic number (without consuming anything):
+// useful for optional chunks
+inline bool peek_chunk(std::istream &from, std::string const &magic) {
+	assert(magic.size() == 4);
+	char header_magic[4];
+	auto pos = from.tellg();
+	bool match = bool(from.read(header_magic, 4)) && std::string(header_magic, 4) == magic;
+	from.clear();
+	from.seekg(pos);
+	return match;
+}
 
 //helper function to write a chunk of data in the same format as read_chunk:
 template< typename T >
@@ -63,3 +124,126 @@ void write_chunk(std::string const &magic, std::vector< T > const &from, std::os
 	to.write(reinterpret_cast< const char * >(&header), sizeof(header));
 	to.write(reinterpret_cast< const char * >(from.data()), from.size() * sizeof(T));
 }
+
+//helper function to write a zlib-compressed chunk (readable by read_chunk and ChunkReader):
+template< typename T >
+void write_compressed_chunk(std::string const &magic, std::vector< T > const &from, std::ostream *to_, int level = 6) {
+	assert(magic.size() == 4);
+	assert(to_);
+	auto &to = *to_;
+
+	uint32_t size = uint32_t(from.size() * sizeof(T));
+	std::vector< uint8_t > compressed = deflate_chunk(from.data(), size, level);
+	if (compressed.size() + 4 >= ChunkCompressedBit) {
+		throw std::runtime_error("Chunk too large to compress");
+	}
+	uint32_t stored = uint32_t(compressed.size() + 4) | ChunkCompressedBit;
+
+	to.write(magic.data(), 4);
+	to.write(reinterpret_cast< const char * >(&stored), 4);
+	to.write(reinterpret_cast< const char * >(&size), 4);
+	to.write(reinterpret_cast< const char * >(compressed.data()), compressed.size());
+}
+
+//---------------------------------------------------------------------------
+//Reading chunks in place (e.g., from a MappedFile) rather than from a stream:
+
+//read-only view of an array of T's:
+template< typename T >
+struct ChunkSpan {
+	ChunkSpan() = default;
+	ChunkSpan(T const *data_, size_t count_) : ptr(data_), count(count_) { }
+	ChunkSpan(std::vector< T > const &from) : ptr(from.data()), count(from.size()) { }
+
+	T const *data() const { return ptr; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T const &operator[](size_t i) const { assert(i < count); return ptr[i]; }
+	T const *begin() const { return ptr; }
+	T const *end() const { return ptr + count; }
+
+	T const *ptr = nullptr;
+	size_t count = 0;
+};
+
+//walks the chunks in a block of memory (same format as read_chunk), returning views into it:
+// - chunk payloads are bounds-checked against the block
+// - payloads that happen to be misaligned for T (e.g., after a 'str0' chunk of odd length)
+//   are copied to aligned storage owned by the reader, as are compressed payloads (decompressed),
+//   so spans are valid as long as both the reader and the underlying memory are
+struct ChunkReader {
+	ChunkReader(uint8_t const *data_, size_t size_, std::string const &name_ = "") : data(data_), size(size_), name(name_) { }
+
+	template< typename T >
+	ChunkSpan< T > read(std::string const &magic) {
+		static_assert(std::is_trivially_copyable< T >::value, "chunks hold plain data");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "copies are only max_align_t aligned");
+		assert(magic.size() == 4);
+
+		if (size - offset < 8) {
+			throw std::runtime_error("Failed to read chunk header" + where());
+		}
+		if (std::memcmp(data + offset, magic.data(), 4) != 0) {
+			throw std::runtime_error("Unexpected magic number in chunk" + where() + " (expected '" + magic + "')");
+		}
+		uint32_t bytes;
+		std::memcpy(&bytes, data + offset + 4, 4);
+		uint32_t stored = bytes & ~ChunkCompressedBit;
+		if (stored > size - offset - 8) {
+			throw std::runtime_error("Chunk extends past end of data" + where());
+		}
+		uint8_t const *payload = data + offset + 8;
+
+		if (bytes & ChunkCompressedBit) {
+			if (stored < 4) {
+				throw std::runtime_error("Failed to read compressed chunk size" + where());
+			}
+			std::memcpy(&bytes, payload, 4);
+			if (!plausible_inflated_size(stored - 4, bytes)) {
+				throw std::runtime_error("Failed to read compressed chunk (uncompressed size too large for its data)" + where());
+			}
+			if (bytes % sizeof(T) != 0) {
+				throw std::runtime_error("Size of chunk not divisible by element size" + where());
+			}
+			if (bytes == 0) {
+				offset += 8 + size_t(stored);
+				return ChunkSpan< T >();
+			}
+			copies.emplace_back(new uint8_t[bytes]);
+			inflate_chunk(payload + 4, stored - 4, copies.back().get(), bytes);
+			offset += 8 + size_t(stored);
+			return ChunkSpan< T >(reinterpret_cast< T const * >(copies.back().get()), bytes / sizeof(T));
+		}
+
+		if (bytes % sizeof(T) != 0) {
+			throw std::runtime_error("Size of chunk not divisible by element size" + where());
+		}
+		offset += 8 + size_t(bytes);
+
+		if (bytes == 0) return ChunkSpan< T >();
+		if (reinterpret_cast< uintptr_t >(payload) % alignof(T) != 0) {
+			copies.emplace_back(new uint8_t[bytes]);
+			std::memcpy(copies.back().get(), payload, bytes);
+			payload = copies.back().get();
+		}
+		return ChunkSpan< T >(reinterpret_cast< T const * >(payload), bytes / sizeof(T));
+	}
+
+	//does the next chunk have this magic number? (useful for optional chunks)
+	bool peek(std::string const &magic) const {
+		assert(magic.size() == 4);
+		return size - offset >= 4 && std::memcmp(data + offset, magic.data(), 4) == 0;
+	}
+
+	bool at_end() const { return offset == size; }
+
+	uint8_t const *data;
+	size_t size;
+	size_t offset = 0;
+	std::string name; //(for error messages)
+	std::vector< std::unique_ptr< uint8_t[] > > copies; //aligned copies of misaligned payloads
+
+	std::string where() const {
+		return (name.empty() ? "" : " in '" + name + "'") + " at offset " + std::to_string(offset);
+	}
+};
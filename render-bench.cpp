@@ -0,0 +1,347 @@
+//render-bench: draws a scene into an offscreen framebuffer along a scripted camera path and reports frame timings.
+// Useful for measuring rendering changes without a visible window (e.g., in CI with Mesa's llvmpipe).
+
+#include "Load.hpp"
+#include "GL.hpp"
+#include "gl_errors.hpp"
+#include "load_save_png.hpp"
+#include "GPUProfiler.hpp"
+#include "StreamBuffer.hpp"
+#include "ShowSceneProgram.hpp"
+#include "Scene.hpp"
+#include "Mesh.hpp"
+
+#include <SDL.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static void usage(char const *argv0) {
+	std::cerr << "Usage:\n\t" << argv0 << " <path/to/scene.scene> <path/to/meshes.pnct> [options]\n"
+		"Options:\n"
+		"\t--frames N        number of timed frames (default: 500)\n"
+		"\t--warmup N        untimed frames drawn first (default: 20)\n"
+		"\t--size WxH        framebuffer size (default: 1280x720)\n"
+		"\t--orbits N        camera orbits around the scene during the timed frames (default: 1)\n"
+		"\t--dump A,B,...    save the listed (timed) frame numbers as PNGs\n"
+		"\t--dump-prefix P   filename prefix for dumped frames (default: 'bench-frame-')\n"
+		"\t--no-lod          always draw meshes at full detail\n"
+		"Runs without showing a window; set SDL_VIDEODRIVER=offscreen to run without a display at all.\n"
+		<< std::endl;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	//------------ command-line options ------------
+	if (argc < 3) {
+		usage(argv[0]);
+		return 1;
+	}
+	std::string scene_file = argv[1];
+	std::string meshes_file = argv[2];
+	uint32_t frames = 500;
+	uint32_t warmup = 20;
+	glm::uvec2 size = glm::uvec2(1280, 720);
+	float orbits = 1.0f;
+	std::set< uint32_t > dump;
+	std::string dump_prefix = "bench-frame-";
+	bool no_lod = false;
+	for (int argi = 3; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		bool has_value = (argi + 1 < argc);
+		if (arg == "--frames" && has_value) {
+			frames = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--warmup" && has_value) {
+			warmup = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--size" && has_value) {
+			std::string value = argv[++argi];
+			if (std::sscanf(value.c_str(), "%ux%u", &size.x, &size.y) != 2 || size.x == 0 || size.y == 0) {
+				std::cerr << "Expected --size WxH, got '" << value << "'." << std::endl;
+				return 1;
+			}
+		} else if (arg == "--orbits" && has_value) {
+			orbits = std::stof(argv[++argi]);
+		} else if (arg == "--dump" && has_value) {
+			std::istringstream list(argv[++argi]);
+			std::string item;
+			while (std::getline(list, item, ',')) {
+				dump.insert(uint32_t(std::stoul(item)));
+			}
+		} else if (arg == "--dump-prefix" && has_value) {
+			dump_prefix = argv[++argi];
+		} else if (arg == "--no-lod") {
+			no_lod = true;
+		} else {
+			std::cerr << "Unrecognized option '" << arg << "'." << std::endl;
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (frames == 0) {
+		std::cerr << "Need at least one frame." << std::endl;
+		return 1;
+	}
+
+	//------------  initialization ------------
+
+	//Initialize SDL library:
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		std::cerr << "Error initializing SDL: " << SDL_GetError() << std::endl;
+		return 1;
+	}
+
+	//Ask for an OpenGL context version 3.3, core profile:
+	// (no debug flag -- it can slow drivers down, which would skew the timings)
+	SDL_GL_ResetAttributes();
+	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+	//create a (never shown) window to own the context; all drawing goes to a framebuffer object:
+	SDL_Window *window = SDL_CreateWindow(
+		"render bench",
+		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		64, 64,
+		SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+	);
+
+	if (!window) {
+		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+		return 1;
+	}
+
+	//Create OpenGL context:
+	SDL_GLContext context = SDL_GL_CreateContext(window);
+
+	if (!context) {
+		SDL_DestroyWindow(window);
+		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+		return 1;
+	}
+
+	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
+	init_GL();
+
+	//No vsync -- frames are never presented anyway:
+	SDL_GL_SetSwapInterval(0);
+
+	std::cout << "GL_RENDERER: " << (char const *)glGetString(GL_RENDERER) << std::endl;
+
+	//------------ offscreen framebuffer ------------
+	GLuint color_rb = 0, depth_rb = 0, fb = 0;
+	glGenRenderbuffers(1, &color_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glGenRenderbuffers(1, &depth_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fb);
+	glBindFramebuffer(GL_FRAMEBUFFER, fb);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_rb);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Offscreen framebuffer is incomplete." << std::endl;
+		return 1;
+	}
+	glViewport(0, 0, size.x, size.y);
+	GL_ERRORS();
+
+	//------------ load resources --------------
+	call_load_functions();
+
+	MeshBuffer *buffer = nullptr;
+	GLuint buffer_vao = 0;
+	Scene scene;
+	try {
+		buffer = new MeshBuffer(meshes_file, MeshBuffer::OptimizeIndices | (no_lod ? 0 : MeshBuffer::GenerateLODs) | MeshBuffer::PrintStats);
+		buffer_vao = buffer->make_vao_for_program(show_scene_program->program);
+		scene.load(scene_file, [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+			Mesh const &mesh = buffer->lookup(mesh_name);
+
+			scene.drawables.emplace_back(transform);
+			Scene::Drawable &drawable = scene.drawables.back();
+
+			drawable.pipeline = show_scene_program_pipeline;
+
+			drawable.pipeline.vao = buffer_vao;
+			drawable.pipeline.set_mesh(mesh);
+		});
+	} catch (std::exception &e) {
+		std::cerr << "ERROR loading '" << scene_file << "' / '" << meshes_file << "': " << e.what() << std::endl;
+		return 1;
+	}
+	std::cout << "Loaded " << scene.drawables.size() << " drawables from '" << scene_file << "'." << std::endl;
+
+	//------------ camera path ------------
+	//the camera orbits the scene's bounding box, looking at its center:
+	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+	for (auto const &drawable : scene.drawables) {
+		if (drawable.pipeline.count == 0) continue;
+		glm::mat4x3 to_world = drawable.transform->make_local_to_world();
+		for (uint32_t c = 0; c < 8; ++c) {
+			glm::vec3 corner = glm::vec3(
+				(c & 1 ? drawable.pipeline.bbox_max.x : drawable.pipeline.bbox_min.x),
+				(c & 2 ? drawable.pipeline.bbox_max.y : drawable.pipeline.bbox_min.y),
+				(c & 4 ? drawable.pipeline.bbox_max.z : drawable.pipeline.bbox_min.z)
+			);
+			glm::vec3 world = to_world * glm::vec4(corner, 1.0f);
+			min = glm::min(min, world);
+			max = glm::max(max, world);
+		}
+	}
+	if (!(min.x <= max.x)) {
+		min = glm::vec3(-1.0f);
+		max = glm::vec3( 1.0f);
+	}
+	glm::vec3 center = 0.5f * (min + max);
+	float radius = std::max(0.5f * glm::length(max - min), 1e-3f);
+
+	scene.transforms.emplace_back();
+	scene.cameras.emplace_back(&scene.transforms.back());
+	Scene::Camera &camera = scene.cameras.back();
+	camera.fovy = glm::radians(60.0f);
+	camera.aspect = float(size.x) / float(size.y);
+	camera.near = 0.01f * radius;
+
+	auto place_camera = [&](float t) {
+		float angle = 2.0f * 3.1415926f * orbits * t;
+		float distance = 1.6f * radius / std::tan(0.5f * camera.fovy);
+		glm::vec3 eye = center + distance * glm::vec3(std::cos(angle) * 0.87f, std::sin(angle) * 0.87f, 0.5f); //(z is up, 30 degrees elevation)
+		glm::vec3 out = glm::normalize(eye - center); //camera looks along -z
+		glm::vec3 right = glm::normalize(glm::cross(glm::vec3(0.0f, 0.0f, 1.0f), out));
+		glm::vec3 up = glm::cross(out, right);
+		camera.transform->position = eye;
+		camera.transform->rotation = glm::quat_cast(glm::mat3(right, up, out));
+	};
+
+	//------------ benchmark ------------
+
+	auto draw_frame = [&]() {
+		gpu_profiler.begin_frame();
+		glBindFramebuffer(GL_FRAMEBUFFER, fb);
+		{ GPUProfiler::Pass pass("clear");
+			glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+			glClearDepth(1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+		{ GPUProfiler::Pass pass("scene");
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_LESS);
+			scene.draw(camera);
+			glDisable(GL_DEPTH_TEST);
+		}
+		gpu_profiler.end_frame();
+		stream_buffer.end_frame();
+		//frames are never presented, so wait for each one explicitly (times then include the GPU's work):
+		glFinish();
+	};
+
+	for (uint32_t f = 0; f < warmup; ++f) {
+		place_camera(0.0f);
+		draw_frame();
+	}
+
+	std::vector< double > frame_ms;
+	frame_ms.reserve(frames);
+	std::vector< float > scene_gpu_ms;
+	scene_gpu_ms.reserve(frames);
+	for (uint32_t f = 0; f < frames; ++f) {
+		place_camera(float(f) / float(frames));
+
+		auto before = std::chrono::high_resolution_clock::now();
+		draw_frame();
+		auto after = std::chrono::high_resolution_clock::now();
+		frame_ms.emplace_back(std::chrono::duration< double, std::milli >(after - before).count());
+
+		float gpu = gpu_profiler.latest_ms("scene");
+		if (gpu >= 0.0f) scene_gpu_ms.emplace_back(gpu);
+
+		if (dump.count(f)) {
+			std::vector< glm::u8vec4 > data(size.x * size.y);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, fb);
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+			std::string filename = dump_prefix + std::to_string(f) + ".png";
+			save_png(filename, size, data.data(), LowerLeftOrigin);
+			std::cout << "Saved frame " << f << " to '" << filename << "'." << std::endl;
+		}
+	}
+	GL_ERRORS();
+
+	//------------ report ------------
+	//(dumped frames include readback time, so they are left out of the statistics)
+	std::vector< double > sorted;
+	for (uint32_t f = 0; f < frames; ++f) {
+		if (!dump.count(f)) sorted.emplace_back(frame_ms[f]);
+	}
+	if (sorted.empty()) sorted = frame_ms;
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&](double p) {
+		size_t i = size_t(std::round(p / 100.0 * double(sorted.size() - 1)));
+		return sorted[std::min(i, sorted.size() - 1)];
+	};
+	double total = 0.0;
+	for (double ms : sorted) total += ms;
+	double mean = total / double(sorted.size());
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "Frames: " << sorted.size() << " at " << size.x << "x" << size.y << "\n";
+	std::cout << "  mean " << mean << " ms (" << (mean > 0.0 ? 1000.0 / mean : 0.0) << " fps)\n";
+	std::cout << "  p50 " << percentile(50.0) << " ms, p90 " << percentile(90.0) << " ms, p95 " << percentile(95.0)
+		<< " ms, p99 " << percentile(99.0) << " ms, max " << sorted.back() << " ms\n";
+	if (!scene_gpu_ms.empty()) {
+		std::sort(scene_gpu_ms.begin(), scene_gpu_ms.end());
+		std::cout << "  scene pass GPU p50 " << scene_gpu_ms[scene_gpu_ms.size() / 2] << " ms\n";
+	}
+	std::cout.flush();
+	print_lazy_load_report(std::cout);
+
+	//------------  teardown ------------
+	glDeleteFramebuffers(1, &fb);
+	glDeleteRenderbuffers(1, &color_rb);
+	glDeleteRenderbuffers(1, &depth_rb);
+
+	SDL_GL_DeleteContext(context);
+	context = 0;
+
+	SDL_DestroyWindow(window);
+	window = NULL;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -3,6 +3,7 @@
 #based on 'export-sprites.py' and 'glsprite.py' from TCHOW Rainbow; code used is released into the public domain.
 #Patched for 15-466-f19 to remove non-pnct formats!
 #Patched for 15-466-f20 to merge data all at once (slightly faster)
+#Patched to optionally write the compact 'pnc2' vertex format (2_10_10_10 normals, half-float texcoords)
 
 #Note: Script meant to be executed within blender 2.9, as per:
 #blender --background --python export-meshes.py -- [...see below...]
@@ -14,8 +15,13 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+compact = False
+if len(args) >= 1 and args[0] == '--compact':
+	compact = True
+	args = args[1:]
+
 if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-meshes.py -- <infile.blend[:collection]> <outfile.pnct>\nExports the meshes referenced by all objects in the specified collection(s) (default: all objects) to a binary blob.\n")
+	print("\n\nUsage:\nblender --background --python export-meshes.py -- [--compact] <infile.blend[:collection]> <outfile.pnct>\nExports the meshes referenced by all objects in the specified collection(s) (default: all objects) to a binary blob.\n  --compact writes 24-byte 'pnc2' vertices (2_10_10_10 normals, half-float texcoords) instead of 32-byte 'pnct' vertices.\n")
 	exit(1)
 
 import bpy
@@ -39,6 +45,14 @@ print(" of '" + infile + "' to '" + outfile + "'.")
 
 import struct
 
+#pack a unit normal as GL_INT_2_10_10_10_REV (signed normalized x,y,z in the low 30 bits):
+def pack_normal(n):
+	bits = 0
+	for c in range(0,3):
+		v = int(round(max(-1.0, min(1.0, n[c])) * 511.0))
+		bits |= (v & 0x3ff) << (10 * c)
+	return struct.pack('I', bits)
+
 bpy.ops.wm.open_mainfile(filepath=infile)
 
 if collection_name:
@@ -97,6 +111,9 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
+#bounds gives the bounding box (min xyz, max xyz) of each mesh, in the same order as index:
+bounds = b''
+
 vertex_count = 0
 for obj in bpy.data.objects:
 	if obj.data in to_write:
@@ -161,6 +178,10 @@ for obj in bpy.data.objects:
 
 	local_data = b''
 
+	#track the bounding box of the mesh's vertices (for the bounds chunk):
+	lo = [float('inf')] * 3
+	hi = [float('-inf')] * 3
+
 	#write the mesh triangles:
 	for poly in mesh.polygons:
 		assert(len(poly.loop_indices) == 3)
@@ -170,8 +191,13 @@ for obj in bpy.data.objects:
 			vertex = mesh.vertices[loop.vertex_index]
 			for x in vertex.co:
 				local_data += struct.pack('f', x)
-			for x in loop.normal:
-				local_data += struct.pack('f', x)
+			lo = [min(a, b) for a, b in zip(lo, vertex.co)]
+			hi = [max(a, b) for a, b in zip(hi, vertex.co)]
+			if compact:
+				local_data += pack_normal(loop.normal)
+			else:
+				for x in loop.normal:
+					local_data += struct.pack('f', x)
 			if colors != None:
 				col = colors[poly.loop_indices[i]].color
 				local_data += struct.pack('BBBB', int(col[0] * 255), int(col[1] * 255), int(col[2] * 255), 255)
@@ -179,9 +205,9 @@ for obj in bpy.data.objects:
 				local_data += struct.pack('BBBB', 255, 255, 255, 255)
 			if uvs != None:
 				uv = uvs[poly.loop_indices[i]].uv
-				local_data += struct.pack('ff', uv.x, uv.y)
+				local_data += struct.pack('ee' if compact else 'ff', uv.x, uv.y)
 			else:
-				local_data += struct.pack('ff', 0, 0)
+				local_data += struct.pack('ee' if compact else 'ff', 0, 0)
 		if len(local_data) > 1000:
 			data.append(local_data)
 			local_data = b''
@@ -191,15 +217,20 @@ for obj in bpy.data.objects:
 
 	index += struct.pack('I', vertex_count) #vertex_end
 
+	bounds += struct.pack('6f', *lo, *hi)
+
 data = b''.join(data)
 
 #check that code created as much data as anticipated:
-assert(vertex_count * (4*3+4*3+1*4+4*2) == len(data))
+if compact:
+	assert(vertex_count * (4*3+4+1*4+2*2) == len(data))
+else:
+	assert(vertex_count * (4*3+4*3+1*4+4*2) == len(data))
 
 #write the data chunk and index chunk to an output blob:
 blob = open(outfile, 'wb')
 #first chunk: the data
-blob.write(struct.pack('4s',b'pnct')) #type
+blob.write(struct.pack('4s',b'pnc2' if compact else b'pnct')) #type
 blob.write(struct.pack('I', len(data))) #length
 blob.write(data)
 #second chunk: the strings
@@ -210,7 +241,11 @@ blob.write(strings)
 blob.write(struct.pack('4s',b'idx0')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
+#fourth chunk: per-mesh bounds (optional; MeshBuffer computes them if missing)
+blob.write(struct.pack('4s',b'bnd0')) #type
+blob.write(struct.pack('I', len(bounds))) #length
+blob.write(bounds)
 wrote = blob.tell()
 blob.close()
 
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index + " + str(len(bounds)+8) + " bytes of bounds] to '" + outfile + "'")
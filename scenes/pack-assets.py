@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+
+#Packs asset files into a single '.pack' file (see AssetPack.hpp) so the game can map one file instead of opening many.
+#(plain python; no blender needed)
+
+import sys, os, struct
+
+args = sys.argv[1:]
+
+if len(args) < 2:
+	print("\n\nUsage:\npython3 pack-assets.py <outfile.pack> <base-dir> [file ...]\nPacks the listed files (default: all .pnct, .scene, and .png files in base-dir) into outfile.pack, named by their path relative to base-dir.\n")
+	exit(1)
+
+outfile = args[0]
+base = args[1]
+files = args[2:]
+
+assert outfile.endswith(".pack")
+
+if len(files) == 0:
+	for name in sorted(os.listdir(base)):
+		if name.endswith(".pnct") or name.endswith(".scene") or name.endswith(".png"):
+			files.append(os.path.join(base, name))
+
+PackAlignment = 64 #must match AssetPack::PackAlignment
+
+def fnv1a64(data):
+	h = 0xcbf29ce484222325
+	for b in data:
+		h ^= b
+		h = (h * 0x100000001b3) & 0xffffffffffffffff
+	return h
+
+def align(x):
+	return (x + PackAlignment - 1) // PackAlignment * PackAlignment
+
+#gather names and file contents:
+names = b""
+contents = []
+for path in files:
+	name = os.path.relpath(path, base).replace(os.sep, '/')
+	with open(path, 'rb') as f:
+		data = f.read()
+	name_begin = len(names)
+	names += name.encode('utf8')
+	contents.append((name, name_begin, len(names), data))
+
+#table of contents comes first, so data offsets start after it:
+EntrySize = 8*4 + 4*4 #must match sizeof(AssetPack::PackEntry)
+toc_size = (8 + EntrySize * len(contents)) + (8 + len(names))
+
+offset = align(toc_size)
+entries = b""
+for (name, name_begin, name_end, data) in contents:
+	entries += struct.pack('QQQQIIII', offset, len(data), len(data), fnv1a64(data), name_begin, name_end, 0, 0)
+	offset = align(offset + len(data))
+
+with open(outfile, 'wb') as blob:
+	blob.write(struct.pack('4s', b'pke0'))
+	blob.write(struct.pack('I', len(entries)))
+	blob.write(entries)
+	blob.write(struct.pack('4s', b'str0'))
+	blob.write(struct.pack('I', len(names)))
+	blob.write(names)
+	for (name, name_begin, name_end, data) in contents:
+		blob.write(b'\0' * (align(blob.tell()) - blob.tell()))
+		blob.write(data)
+		print("  " + name + " (" + str(len(data)) + " bytes)")
+
+print("Wrote " + str(len(contents)) + " files to '" + outfile + "'.")
@@ -3,6 +3,10 @@
 #include "Load.hpp"
 #include "GL.hpp"
 #include "load_save_png.hpp"
+#include "GPUProfiler.hpp"
+#include "StreamBuffer.hpp"
+#include "ScreenCapture.hpp"
+#include "Texture.hpp"
 
 #include <SDL.h>
 
@@ -81,9 +85,18 @@ int main(int argc, char **argv) {
 	//------------ create game mode + make current --------------
 	bool usage = false;
 	MeshBuffer *buffer = nullptr;
-	if (argc == 2) {
+	TextureSet *textures = nullptr;
+	if (argc >= 2) {
 		try {
 			buffer = new MeshBuffer(argv[1]);
+			//any further arguments are textures to try on the meshes (packed into atlas pages with --atlas):
+			std::vector< std::string > filenames;
+			uint32_t texture_flags = 0;
+			for (int argi = 2; argi < argc; ++argi) {
+				if (std::string(argv[argi]) == "--atlas") texture_flags |= TextureSet::Atlas;
+				else filenames.emplace_back(argv[argi]);
+			}
+			if (!filenames.empty()) textures = new TextureSet(filenames, texture_flags);
 		} catch (std::exception &e) {
 			std::cerr << "ERROR: " << e.what() << std::endl;
 			usage = true;
@@ -91,13 +104,13 @@ int main(int argc, char **argv) {
 		}
 	}
 	if (buffer) {
-		Mode::set_current(std::make_shared< ShowMeshesMode >(*buffer));
+		Mode::set_current(std::make_shared< ShowMeshesMode >(*buffer, textures));
 	}
 	if (!Mode::current) {
 		usage = true;
 	}
 	if (usage) {
-		std::cerr << "Usage:\n\t" << argv[0] << " [path/to/meshes.pnct]" << std::endl;
+		std::cerr << "Usage:\n\t" << argv[0] << " [path/to/meshes.pnct] [--atlas] [path/to/texture.png ...]" << std::endl;
 		return 1;
 	}
 
@@ -136,20 +149,13 @@ int main(int argc, char **argv) {
 				} else if (evt.type == SDL_QUIT) {
 					Mode::set_current(nullptr);
 					break;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F1) {
+					// --- GPU timing overlay toggle ---
+					gpu_profiler.show_overlay = !gpu_profiler.show_overlay;
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GL_GetDrawableSize(window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
-					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+					//(saved in the background once the next frame has been drawn)
+					screen_capture.screenshot("screenshot.png");
 				}
 			}
 			if (!Mode::current) break;
@@ -170,8 +176,12 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			gpu_profiler.begin_frame();
 			Mode::current->draw(drawable_size);
+			gpu_profiler.draw_overlay(drawable_size);
+			gpu_profiler.end_frame();
+			stream_buffer.end_frame();
+			screen_capture.end_frame(drawable_size);
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
@@ -180,6 +190,7 @@ int main(int argc, char **argv) {
 
 
 	//------------  teardown ------------
+	screen_capture.finish();
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
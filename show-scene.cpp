@@ -3,6 +3,9 @@
 #include "Load.hpp"
 #include "GL.hpp"
 #include "load_save_png.hpp"
+#include "GPUProfiler.hpp"
+#include "StreamBuffer.hpp"
+#include "ScreenCapture.hpp"
 #include "ShowSceneProgram.hpp"
 
 #include <SDL.h>
@@ -95,7 +98,7 @@ int main(int argc, char **argv) {
 	GLuint buffer_vao = 0;
 	if (meshes_file != "") {
 		try {
-			buffer = new MeshBuffer(meshes_file);
+			buffer = new MeshBuffer(meshes_file, MeshBuffer::OptimizeIndices | MeshBuffer::GenerateLODs);
 			buffer_vao = buffer->make_vao_for_program(show_scene_program->program);
 		} catch (std::exception &e) {
 			std::cerr << "ERROR loading mesh buffer '" << meshes_file << "': " << e.what() << std::endl;
@@ -109,7 +112,11 @@ int main(int argc, char **argv) {
 			scene = new Scene();
 			scene->load(scene_file, [&buffer,&buffer_vao](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
 				if (!buffer_vao) return;
-				Mesh const &mesh = buffer->lookup(mesh_name);
+				Mesh const *mesh = buffer->try_lookup(mesh_name);
+				if (!mesh) {
+					std::cerr << "WARNING: scene refers to mesh '" << mesh_name << "', which isn't in the mesh buffer; skipping." << std::endl;
+					return;
+				}
 
 				scene.drawables.emplace_back(transform);
 				Scene::Drawable &drawable = scene.drawables.back();
@@ -117,9 +124,7 @@ int main(int argc, char **argv) {
 				drawable.pipeline = show_scene_program_pipeline;
 
 				drawable.pipeline.vao = buffer_vao;
-				drawable.pipeline.type = mesh.type;
-				drawable.pipeline.start = mesh.start;
-				drawable.pipeline.count = mesh.count;
+				drawable.pipeline.set_mesh(*mesh);
 
 			});
 		} catch (std::exception &e) {
@@ -178,20 +183,13 @@ int main(int argc, char **argv) {
 				} else if (evt.type == SDL_QUIT) {
 					Mode::set_current(nullptr);
 					break;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F1) {
+					// --- GPU timing overlay toggle ---
+					gpu_profiler.show_overlay = !gpu_profiler.show_overlay;
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GL_GetDrawableSize(window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
-					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+					//(saved in the background once the next frame has been drawn)
+					screen_capture.screenshot("screenshot.png");
 				}
 			}
 			if (!Mode::current) break;
@@ -212,8 +210,12 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			gpu_profiler.begin_frame();
 			Mode::current->draw(drawable_size);
+			gpu_profiler.draw_overlay(drawable_size);
+			gpu_profiler.end_frame();
+			stream_buffer.end_frame();
+			screen_capture.end_frame(drawable_size);
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
@@ -222,6 +224,7 @@ int main(int argc, char **argv) {
 
 
 	//------------  teardown ------------
+	screen_capture.finish();
 	SDL_GL_DeleteContext(context);
 	context = 0;
 